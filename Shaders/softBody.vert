@@ -5,6 +5,22 @@ layout(location = 2) in vec2 vertex_texture;
 layout(location = 3) in mat4 instance_trans;
 layout(location = 7) in float texture_depth;
 
+// visual vertex embedded in a tetrahedron
+struct Embedding {
+  vec3 bary; // barycentric coords of the first three tetrahedron vertices
+  int tet;   // tetrahedron index
+};
+
+layout(std430, binding = 3) readonly buffer TetraMap {
+  Embedding embeddings[];
+};
+layout(std430, binding = 4) readonly buffer Tetras {
+  ivec4 tetras[];
+};
+layout(std430, binding = 5) readonly buffer TetraPositions {
+  vec4 positions[];
+};
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
@@ -12,9 +28,17 @@ out float tDepth;
 
 uniform mat4 view;
 uniform mat4 proj;
+uniform bool gpuSkinning; // compute the position from the tetrahedral mesh instead of `vertex_position`
 
 void main() {
-  FragPos = vec3(instance_trans * vec4(vertex_position, 1.0));
+  vec3 pos = vertex_position;
+  if (gpuSkinning) {
+    Embedding e = embeddings[gl_VertexID];
+    ivec4 t = tetras[e.tet];
+    vec4 b = vec4(e.bary, 1.0 - e.bary.x - e.bary.y - e.bary.z);
+    pos = positions[t.x].xyz * b.x + positions[t.y].xyz * b.y + positions[t.z].xyz * b.z + positions[t.w].xyz * b.w;
+  }
+  FragPos = vec3(instance_trans * vec4(pos, 1.0));
   Normal = mat3(transpose(inverse(instance_trans))) * vertex_normal;
   TexCoords = vertex_texture;
   tDepth = texture_depth;
@@ -0,0 +1,81 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <thread>
+
+#if __has_include(<tbb/global_control.h>)
+#include <tbb/global_control.h>
+#define BENCH_HAS_TBB
+#endif
+
+#include "softbody.h"
+#include "world.h"
+
+// Shared helpers for the benchmark target.
+// Every soft body case takes the (approximate) number of tetrahedra as its first argument. Parallel cases take the number of threads
+// used by `std::execution::par` as their second (0 = default) when TBB is available. Sizes go up to 2^20 tetrahedra by default; set `BENCH_MAX_TETS` to sweep further.
+namespace Bench {
+
+// Get a headless cube soft body with roughly `tetraCount` tetrahedra, with `surfaceRes` * `surfaceRes` visual quads per surface cell.
+// Bodies are generated once and cached between benchmarks
+inline SoftBody* getBody(long long tetraCount, int surfaceRes = 1) {
+    static std::map<std::pair<long long, int>, std::unique_ptr<SoftBody>> bodies;
+    auto& sb = bodies[{tetraCount, surfaceRes}];
+    if (!sb) {
+        ProcMesh::TetMesh tm = ProcMesh::cube(ProcMesh::subdivisionsFor(tetraCount), 2, surfaceRes);
+        sb = std::make_unique<SoftBody>("Bench" + std::to_string(tetraCount), tm, false);
+        sb->sdt = sb->dt / sb->substeps;
+    }
+    return sb.get();
+}
+
+// Limit the number of worker threads to the benchmark's second argument (if any) for the lifetime of this object
+struct ThreadLimit {
+    ThreadLimit(const benchmark::State& state) {
+#ifdef BENCH_HAS_TBB
+        if (state.range(1) > 0) {
+            control = std::make_unique<tbb::global_control>(tbb::global_control::max_allowed_parallelism, state.range(1));
+        }
+#endif
+    }
+#ifdef BENCH_HAS_TBB
+    std::unique_ptr<tbb::global_control> control;
+#endif
+};
+
+// Tetrahedra counts: 1k, 8k, 64k, ... up to `BENCH_MAX_TETS`
+inline std::vector<long long> tetraCounts() {
+    long long maxTets = 1 << 20;
+    if (const char* env = std::getenv("BENCH_MAX_TETS")) maxTets = std::atoll(env);
+    std::vector<long long> counts;
+    for (long long n = 1 << 10; n <= maxTets; n *= 8) counts.push_back(n);
+    return counts;
+}
+
+// Tetrahedra counts only, for single-threaded cases
+inline void sizes(benchmark::internal::Benchmark* b) {
+    b->ArgName("tets");
+    for (long long n : tetraCounts()) b->Arg(n);
+}
+
+// Tetrahedra counts crossed with thread counts (when TBB is available)
+inline void sizeArgs(benchmark::internal::Benchmark* b) {
+    std::vector<int> threads = {0};
+#ifdef BENCH_HAS_TBB
+    threads = {1, 2, 4};
+    int hw = std::thread::hardware_concurrency();
+    if (hw > 4) threads.push_back(hw);
+#endif
+    b->ArgNames({"tets", "threads"});
+    for (long long n : tetraCounts()) {
+        for (int t : threads) b->Args({n, t});
+    }
+}
+};  // namespace Bench
+
+#endif /* BENCH_H */
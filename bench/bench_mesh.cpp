@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "bonemesh.h"
+
+// split a line of `n` tokens, formatted like a .tetra vertex line
+static void BM_UtilSplit(benchmark::State& state) {
+    std::string line = "v";
+    for (int i = 0; i < state.range(0); ++i) line += " " + std::to_string(i * 0.25f);
+    for (auto _ : state) {
+        std::vector<std::string> vals = Util::split(line, " ");
+        benchmark::DoNotOptimize(vals);
+    }
+    state.SetItemsProcessed(state.iterations() * (state.range(0) + 1));
+}
+BENCHMARK(BM_UtilSplit)->ArgName("tokens")->RangeMultiplier(8)->Range(4, 4096);
+
+// fill an animation with `keys` evenly spaced keyframes
+static void fillKeys(Mesh::Animation& anim, int keys) {
+    for (int k = 0; k < keys; ++k) {
+        anim.positionKeys[k] = vec4(k, k * 0.5f, 0, k);
+        anim.scalingKeys[k] = vec4(1 + k * 0.1f, 1, 1, k);
+        anim.rotationKeys[k] = quat(1, 0, k * 0.01f, 0);
+        anim.rotationKeysTimes[k] = k;
+    }
+    anim.relTransformation = mat4(1);
+    anim.globalInvTransform = mat4(1);
+    anim.animationLength = keys - 1;
+}
+
+// skeleton of `n` bones, laid out as a binary tree
+static void BM_LoadAnimation(benchmark::State& state) {
+    int n = state.range(0);
+    SkinnedMesh sk;
+    sk.animations.resize(n);
+    for (int i = 0; i < n; ++i) {
+        Mesh::BoneInfo bi(i);
+        if (2 * i + 1 < n) bi.children[0] = 2 * i + 1;
+        if (2 * i + 2 < n) bi.children[1] = 2 * i + 2;
+        sk.boneInfos.push_back(bi);
+        fillKeys(sk.animations[i], MAX_KEYFRAMES);
+        sk.animations[i].boneIndex = i;
+    }
+    float t = 0;
+    for (auto _ : state) {
+        std::vector<mat4> trans = sk.loadAnimation(t);
+        benchmark::DoNotOptimize(trans);
+        t = fmod(t + 0.37f, MAX_KEYFRAMES - 2);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_LoadAnimation)->ArgName("bones")->RangeMultiplier(4)->Range(4, 1024);
+
+// sample an animation with `keys` keyframes at 256 evenly spaced times
+template <typename F>
+static void interpolateBench(benchmark::State& state, F interpolate) {
+    int keys = state.range(0);
+    Mesh::Animation anim;
+    fillKeys(anim, keys);
+    std::vector<float> times(256);
+    for (int i = 0; i < times.size(); ++i) times[i] = (keys - 1) * (i + 0.5f) / times.size();
+    for (auto _ : state) {
+        for (float t : times) benchmark::DoNotOptimize(interpolate(anim, t));
+    }
+    state.SetItemsProcessed(state.iterations() * times.size());
+}
+
+static void BM_InterpolatePosition(benchmark::State& state) {
+    interpolateBench(state, [](Mesh::Animation& a, float t) { return a.interpolatePosition(t); });
+}
+static void BM_InterpolateScale(benchmark::State& state) {
+    interpolateBench(state, [](Mesh::Animation& a, float t) { return a.interpolateScale(t); });
+}
+static void BM_InterpolateRotation(benchmark::State& state) {
+    interpolateBench(state, [](Mesh::Animation& a, float t) { return a.interpolateRotation(t); });
+}
+BENCHMARK(BM_InterpolatePosition)->ArgName("keys")->RangeMultiplier(2)->Range(2, MAX_KEYFRAMES);
+BENCHMARK(BM_InterpolateScale)->ArgName("keys")->RangeMultiplier(2)->Range(2, MAX_KEYFRAMES);
+BENCHMARK(BM_InterpolateRotation)->ArgName("keys")->RangeMultiplier(2)->Range(2, MAX_KEYFRAMES);
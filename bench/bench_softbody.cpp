@@ -0,0 +1,340 @@
+#include <filesystem>
+#include <random>
+
+#include "bench.h"
+#include "batchsoftbody.h"
+#include "streamingsoftbody.h"
+
+static void BM_SolveEdgeConstraint(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->solveEdgeConstraint();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->edges.size());
+    state.counters["edges"] = sb->edges.size();
+}
+BENCHMARK(BM_SolveEdgeConstraint)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_SolveVolumeConstraint(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->solveVolumeConstraint();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tetras.size());
+    state.counters["tets"] = sb->tetras.size();
+}
+BENCHMARK(BM_SolveVolumeConstraint)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// one fused pass, comparable to an edge pass plus a volume pass
+static void BM_SolveFEMConstraint(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->solveFEMConstraint();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tetras.size());
+    state.counters["tets"] = sb->tetras.size();
+}
+BENCHMARK(BM_SolveFEMConstraint)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// edges and volumes cluster by cluster, then the coloured boundary pass. compare with BM_SolveEdgeConstraint plus BM_SolveVolumeConstraint
+static void BM_SolvePartitioned(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    if (sb->partitionEdgeOffsets.empty()) sb->initPartitions();
+    for (auto _ : state) {
+        sb->solvePartitioned();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * (sb->edges.size() + sb->tetras.size()));
+    state.counters["partitions"] = sb->partitionIDs.size();
+    state.counters["boundary"] = sb->boundaryEdges.size() + sb->boundaryTetras.size();
+}
+BENCHMARK(BM_SolvePartitioned)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// one shape matching pass; the clusters are built before timing starts
+static void BM_SolveShapeMatching(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    if (sb->clusterOffsets.empty()) sb->initClusters();
+    for (auto _ : state) {
+        sb->solveShapeMatching();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tVertexCount);
+    state.counters["clusters"] = sb->clusterIDs.size();
+}
+BENCHMARK(BM_SolveShapeMatching)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// hash rebuild plus one contact pass, as run every substep
+static void BM_SolveSelfCollision(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    if (sb->surfaceVertices.empty()) sb->initSelfCollision();
+    for (auto _ : state) {
+        sb->solveSelfCollision();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->surfaceVertices.size());
+    state.counters["verts"] = sb->surfaceVertices.size();
+}
+BENCHMARK(BM_SolveSelfCollision)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// visual mesh is 4x denser than the tetrahedral mesh's surface
+static void BM_UpdateVisualMesh(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0), 4);
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->updateVisualMesh();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->mVertexCount);
+    state.counters["visual_vertices"] = sb->mVertexCount;
+}
+BENCHMARK(BM_UpdateVisualMesh)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_UpdateNormals(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0), 4);
+    Bench::ThreadLimit threads(state);
+    sb->initNormals();
+    for (auto _ : state) {
+        sb->updateNormals(sb->mesh->vertices.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->mVertexCount);
+    state.counters["visual_vertices"] = sb->mVertexCount;
+}
+BENCHMARK(BM_UpdateNormals)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_BuildTetBVH(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->buildTetBVH();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tetraCount);
+}
+BENCHMARK(BM_BuildTetBVH)->Apply(Bench::sizeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_RefitSurface(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->refitSurface();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->surfaceFaces.size());
+    state.counters["faces"] = sb->surfaceFaces.size();
+}
+BENCHMARK(BM_RefitSurface)->Apply(Bench::sizeArgs)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// rays from in front of the body towards random points on it
+static void BM_Raycast(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    sb->refitSurface();
+    std::vector<vec3> targets(1024);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> d(-1, 1);
+    for (auto& p : targets) p = vec3(d(gen), d(gen) + 1, d(gen));
+    vec3 origin = vec3(0, 1, 5);
+    SoftBody::RayHit hit;
+    for (auto _ : state) {
+        for (const auto& p : targets) benchmark::DoNotOptimize(sb->raycast(origin, normalize(p - origin), hit));
+    }
+    state.SetItemsProcessed(state.iterations() * targets.size());
+}
+BENCHMARK(BM_Raycast)->Apply(Bench::sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_ComputeSkinningInfo(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    for (auto _ : state) {
+        sb->computeSkinningInfo();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->mVertexCount);
+    state.counters["visual_vertices"] = sb->mVertexCount;
+}
+BENCHMARK(BM_ComputeSkinningInfo)->Apply(Bench::sizeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// radius queries of two cells at random points within the body
+static void BM_QueryNearbyMV(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    if (sb->cellToVis.empty()) sb->initHash();
+    std::vector<vec3> points(1024);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> d(-1, 1);
+    for (auto& p : points) p = vec3(d(gen), d(gen) + 1, d(gen));
+    for (auto _ : state) {
+        for (const auto& p : points) {
+            sb->queryNearbyMV(p, sb->cellSize * 2);
+            benchmark::DoNotOptimize(sb->queryIDs);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_QueryNearbyMV)->Apply(Bench::sizes)->Unit(benchmark::kMicrosecond);
+
+static void BM_LoadTetraFile(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    // a fresh file for this run, so one left by another process or an older build is never read
+    std::string name = "bench" + std::to_string(state.range(0)) + "_" + std::to_string(std::random_device()()) + ".tetra";
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    ProcMesh::TetMesh tm = ProcMesh::cube(ProcMesh::subdivisionsFor(state.range(0)), 2);
+    if (!ProcMesh::writeTetraFile(tm, path)) {
+        std::filesystem::remove(path);
+        state.SkipWithError("could not write the tetra file");
+        return;
+    }
+    SoftBody loaded = *sb;
+    for (auto _ : state) {
+        loaded.vertices.clear();
+        loaded.edges.clear();
+        loaded.tetras.clear();
+        loaded.tetraNeighbours.clear();
+        loaded.loadTetraFile(path);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * loaded.tetras.size());
+    state.SetBytesProcessed(state.iterations() * std::filesystem::file_size(path));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_LoadTetraFile)->Apply(Bench::sizes)->Unit(benchmark::kMillisecond);
+
+// bodies scattered on a plane, jittered a little every iteration so the sweep order changes like it would between frames
+static void BM_Broadphase(benchmark::State& state) {
+    int n = state.range(0);
+    std::vector<std::unique_ptr<SoftBody>> bodies;
+    PhysicsWorld world;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> d(0, 1);
+    float extent = sqrt((float)n) * 3;
+    ProcMesh::TetMesh tm = ProcMesh::cube(2, 1);
+    for (int i = 0; i < n; ++i) {
+        bodies.push_back(std::make_unique<SoftBody>("Broadphase" + std::to_string(i), tm, false));
+        bodies.back()->transform = translate(mat4(1), vec3(d(gen) * extent, 0, d(gen) * extent));
+        world.add(bodies.back().get());
+    }
+    world.updateBounds();
+    world.broadphase();
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& b : bodies) b->transform = translate(b->transform, vec3(0.02f * (d(gen) - 0.5f), 0, 0));
+        world.updateBounds();
+        state.ResumeTiming();
+        world.broadphase();
+        benchmark::DoNotOptimize(world.pairs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+    state.counters["pairs"] = world.pairs.size();
+}
+BENCHMARK(BM_Broadphase)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+// a full step at each simulation level, and the cost of switching down and back up again
+static void BM_UpdateAtLOD(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    if (sb->levels.size() < 3) sb->buildLODs(3);
+    sb->setLOD(state.range(1));
+    for (auto _ : state) {
+        sb->update();
+        benchmark::ClobberMemory();
+    }
+    state.counters["tets"] = sb->tetraCount;
+    sb->setLOD(0);
+}
+BENCHMARK(BM_UpdateAtLOD)->Apply([](benchmark::internal::Benchmark* b) {
+    b->ArgNames({"tets", "level"});
+    for (long long n : Bench::tetraCounts()) {
+        for (int level = 0; level < 3; ++level) b->Args({n, level});
+    }
+})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_SetLOD(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    if (sb->levels.size() < 3) sb->buildLODs(3);
+    for (auto _ : state) {
+        sb->setLOD(1);
+        sb->setLOD(0);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tVertexCount);
+}
+BENCHMARK(BM_SetLOD)->Apply(Bench::sizes)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// the skyline grows faster than the mesh, so sizes stop at 64k tetrahedra
+static void projectiveSizes(benchmark::internal::Benchmark* b) {
+    b->ArgName("tets");
+    for (long long n : Bench::tetraCounts()) {
+        if (n <= 1 << 16) b->Arg(n);
+    }
+}
+
+static void BM_FactorProjective(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    for (auto _ : state) {
+        sb->initProjective();
+        benchmark::ClobberMemory();
+    }
+    state.counters["stored"] = sb->projective.cholesky.values.size();
+}
+BENCHMARK(BM_FactorProjective)->Apply(projectiveSizes)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// one substep's local/global iterations
+static void BM_SolveProjective(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    sb->initProjective();
+    for (auto _ : state) {
+        sb->solveProjective();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sb->tetras.size() * sb->projectiveIterations);
+}
+BENCHMARK(BM_SolveProjective)->Apply(projectiveSizes)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// a full step of W instances in lockstep. compare with BM_UpdateAtLOD at level 0, which steps one body
+template <int W>
+static void BM_UpdateBatch(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    BatchSoftBody<W> batch(*sb);
+    for (int l = 0; l < W; ++l) batch.edgeCompliance[l] = sb->edgeCompliance * (l + 1);
+    for (auto _ : state) {
+        batch.update();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * W * sb->tetras.size());
+    state.counters["tets"] = sb->tetras.size();
+}
+BENCHMARK_TEMPLATE(BM_UpdateBatch, 8)->Apply(Bench::sizeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_UpdateBatch, 16)->Apply(Bench::sizeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// a full step with the topology streamed from a mapped store, a chunk at a time. compare with BM_UpdateAtLOD at level 0
+static void BM_UpdateStreaming(benchmark::State& state) {
+    SoftBody* sb = Bench::getBody(state.range(0));
+    Bench::ThreadLimit threads(state);
+    // a fresh store for this run, so one left by another process or an older build is never read
+    std::string name = "bench" + std::to_string(state.range(0)) + "_" + std::to_string(std::random_device()()) + ".tets";
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    StreamingSoftBody body;
+    if (!TetStore::write(path, *sb) || !body.load(path)) {
+        std::filesystem::remove(path);
+        state.SkipWithError("could not write or map the store");
+        return;
+    }
+    for (auto _ : state) {
+        body.update();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * body.store.header.tetraCount);
+    state.SetBytesProcessed(state.iterations() * body.substeps * (body.store.file.size - body.store.edgeOffset));
+    state.counters["chunks"] = body.store.header.chunkCount;
+    body.store.file.close();  // a mapped file cannot be removed on Windows
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_UpdateStreaming)->Apply(Bench::sizeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
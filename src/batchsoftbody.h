@@ -0,0 +1,219 @@
+#ifndef BATCHSOFTBODY_H
+#define BATCHSOFTBODY_H
+
+#include <execution>
+#include <numeric>
+#include <vector>
+
+#include "softbody.h"
+#include "trace.h"
+
+// GCC vector types for W lanes. vector_size cannot depend on a template parameter, so each supported width is spelled out
+template <int W>
+struct LaneTypes;
+template <>
+struct LaneTypes<8> {
+    typedef float Lanes __attribute__((vector_size(32)));
+    typedef int Mask __attribute__((vector_size(32)));
+};
+template <>
+struct LaneTypes<16> {
+    typedef float Lanes __attribute__((vector_size(64)));
+    typedef int Mask __attribute__((vector_size(64)));
+};
+
+// W copies of one soft body stepped in lockstep, for sweeping parameters over the same asset. each per-vertex value is stored lane-interleaved:
+// W floats per component, one lane per instance, so every constraint is projected on all instances by the same vector instructions.
+// the instances share the topology, rest state and masses of the body they are made from, while the parameters that are swept hold a lane each.
+// only the XPBD edge and volume constraints, gravity and the floor are simulated, in the body's space. W is 8 for AVX2 and 16 for AVX-512;
+// without those enabled (e.g. -mavx2) the compiler splits each operation over narrower registers
+template <int W>
+class BatchSoftBody {
+   public:
+    typedef typename LaneTypes<W>::Lanes Lanes;  // one float per instance
+    typedef typename LaneTypes<W>::Mask Mask;    // result of comparing lanes: -1 where true, 0 where false
+
+    struct Lanes3 {
+        Lanes x, y, z;
+    };
+
+    BatchSoftBody(const SoftBody& body) {
+        edges = body.edges;
+        tetras = body.tetras;
+        dt = body.dt;
+        substeps = body.substeps;
+        vertexCount = body.vertices.size();
+        positions.resize(vertexCount);
+        velocities.resize(vertexCount);
+        invMass.resize(vertexCount);
+        for (int i = 0; i < vertexCount; ++i) {
+            const SoftBody::Vertex& v = body.vertices[i];
+            splat(positions[i], v.position);
+            splat(velocities[i], v.velocity);
+            invMass[i] = v.invMass;
+        }
+        previousPositions = positions;
+        vIndices.resize(vertexCount);
+        std::iota(vIndices.begin(), vIndices.end(), 0);
+        splat(edgeCompliance, body.edgeCompliance);
+        splat(volumeCompliance, body.volumeCompliance);
+        splat(gravity, body.gravity);
+        splat(floorY, body.floorY);
+        splat(friction, body.friction);
+    }
+
+    // the helpers take lanes by reference and hand results back through a reference or a `Lanes3`, never as a bare `Lanes`: unless the
+    // compiler targets the width (AVX for 8 lanes, AVX-512 for 16) a vector passed by value changes the calling convention (-Wpsabi).
+    // lanes are chosen between with `mask ? a : b`, and mix with scalars directly
+    static void splat(Lanes& v, float s) {
+        for (int l = 0; l < W; ++l) v[l] = s;
+    }
+    static void splat(Lanes3& v, vec3 s) {
+        splat(v.x, s.x);
+        splat(v.y, s.y);
+        splat(v.z, s.z);
+    }
+
+    static void sqrt(Lanes& a) {
+        for (int l = 0; l < W; ++l) a[l] = std::sqrt(a[l]);
+    }
+
+    static void dot(Lanes& out, const Lanes3& a, const Lanes3& b) { out = a.x * b.x + a.y * b.y + a.z * b.z; }
+    static Lanes3 sub(const Lanes3& a, const Lanes3& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+    static Lanes3 cross(const Lanes3& a, const Lanes3& b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+    static void addScaled(Lanes3& a, const Lanes& s, const Lanes3& b) {
+        a.x += s * b.x;
+        a.y += s * b.y;
+        a.z += s * b.z;
+    }
+
+    // position of vertex `i` in instance `instance`
+    vec3 position(int instance, int i) const { return vec3(positions[i].x[instance], positions[i].y[instance], positions[i].z[instance]); }
+
+    void update() {
+        TRACE_SCOPE_CAT("BatchSoftBody::update", "sim");
+        sdt = dt / substeps;
+        for (int s = 0; s < substeps; ++s) {
+            integrate();
+            solveEdgeConstraint();
+            solveVolumeConstraint();
+            constrainFloor();
+            updateVelocities();
+        }
+    }
+
+    void integrate() {
+        Lanes fall = gravity * sdt, step;
+        splat(step, sdt);
+        std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+            if (invMass[i] == 0) return;
+            velocities[i].y -= fall;
+            previousPositions[i] = positions[i];
+            addScaled(positions[i], step, velocities[i]);
+        });
+    }
+
+    // as `SoftBody::solveEdge`, on every instance at once. a zero-length edge has no direction to push in, so its lanes are left alone
+    void solveEdgeConstraint() {
+        TRACE_SCOPE_CAT("BatchSoftBody::solveEdgeConstraint", "sim");
+        Lanes alpha = edgeCompliance / (sdt * sdt);
+        std::for_each(std::execution::par, edges.begin(), edges.end(), [&](const SoftBody::Edge& e) {
+            float w1 = invMass[e.x1], w2 = invMass[e.x2];
+            if (w1 + w2 == 0) return;
+            Lanes3 d = sub(positions[e.x1], positions[e.x2]);
+            Lanes l;
+            dot(l, d, d);
+            sqrt(l);
+            Lanes lambda = -(l - e.restLength) / ((w1 + w2 + alpha) * (l > 0 ? l : 1.f));
+            lambda = l > 0 ? lambda : 0.f;
+            addScaled(positions[e.x1], lambda * w1, d);
+            addScaled(positions[e.x2], -lambda * w2, d);
+        });
+    }
+
+    // as `SoftBody::solveTetra`, on every instance at once
+    void solveVolumeConstraint() {
+        TRACE_SCOPE_CAT("BatchSoftBody::solveVolumeConstraint", "sim");
+        Lanes alpha = volumeCompliance / (sdt * sdt);
+        std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](const SoftBody::Tetra& tet) {
+            float w1 = invMass[tet.x1], w2 = invMass[tet.x2], w3 = invMass[tet.x3], w4 = invMass[tet.x4];
+            if (w1 + w2 + w3 + w4 == 0) return;
+            const Lanes3 &p1 = positions[tet.x1], &p2 = positions[tet.x2], &p3 = positions[tet.x3], &p4 = positions[tet.x4];
+            Lanes3 grad1 = cross(sub(p4, p2), sub(p3, p2));
+            Lanes3 grad2 = cross(sub(p3, p1), sub(p4, p1));
+            Lanes3 grad3 = cross(sub(p4, p1), sub(p2, p1));
+            Lanes3 grad4 = cross(sub(p2, p1), sub(p3, p1));
+            // the gradients are kept 6 times too long, which scales the denominator by 36
+            Lanes g1, g2, g3, g4;
+            dot(g1, grad1, grad1);
+            dot(g2, grad2, grad2);
+            dot(g3, grad3, grad3);
+            dot(g4, grad4, grad4);
+            Lanes denom = w1 * g1 + w2 * g2 + w3 * g3 + w4 * g4;
+            Mask valid = denom > 0;
+            denom = denom / 36 + alpha;
+            Lanes C;
+            dot(C, grad4, sub(p4, p1));
+            C = C / 6 - tet.restVolume;
+            Lanes lambda = valid ? -C / (6 * (valid ? denom : 1.f)) : 0.f;
+            addScaled(positions[tet.x1], lambda * w1, grad1);
+            addScaled(positions[tet.x2], lambda * w2, grad2);
+            addScaled(positions[tet.x3], lambda * w3, grad3);
+            addScaled(positions[tet.x4], lambda * w4, grad4);
+        });
+    }
+
+    // the floor part of `SoftBody::constrainBounds`: stop each vertex where its substep motion crosses the floor, then cut its sliding by friction
+    void constrainFloor() {
+        TRACE_SCOPE_CAT("BatchSoftBody::constrainFloor", "sim");
+        std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+            if (invMass[i] == 0) return;
+            Lanes3& p1 = positions[i];
+            const Lanes3& p0 = previousPositions[i];
+            Lanes s0 = p0.y - floorY, s1 = p1.y - floorY;
+            Mask hit = s1 < 0;
+            Lanes t = s0 > 0 ? s0 / (s0 > 0 ? s0 - s1 : 1.f) : 0.f;
+            Lanes cx = p0.x + (p1.x - p0.x) * t, cz = p0.z + (p1.z - p0.z) * t;
+            Lanes rx = p1.x - cx, rz = p1.z - cz;
+            Lanes depth = -s1;
+            Lanes l = rx * rx + rz * rz;
+            sqrt(l);
+            Lanes keep = 1 - friction * depth / (l > 0 ? l : 1.f);
+            keep = keep > 0 ? keep : 0.f;
+            p1.x = hit ? cx + rx * keep : p1.x;
+            p1.y = hit ? floorY : p1.y;
+            p1.z = hit ? cz + rz * keep : p1.z;
+        });
+    }
+
+    void updateVelocities() {
+        float invStep = 1 / sdt;
+        std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+            if (invMass[i] == 0) return;
+            velocities[i] = {(positions[i].x - previousPositions[i].x) * invStep, (positions[i].y - previousPositions[i].y) * invStep,
+                             (positions[i].z - previousPositions[i].z) * invStep};
+        });
+    }
+
+    std::vector<Lanes3> positions;           // lane-interleaved positions of each vertex
+    std::vector<Lanes3> previousPositions;   // positions at the start of the substep
+    std::vector<Lanes3> velocities;
+    std::vector<float> invMass;              // shared by every instance
+    std::vector<SoftBody::Edge> edges;
+    std::vector<SoftBody::Tetra> tetras;
+    std::vector<int> vIndices;               // 0 to the vertex count, for iterating vertices in parallel
+    int vertexCount = 0;
+
+    /* Per-instance parameters, one lane each. set lane l with e.g. `gravity[l] = 9.8f` */
+    Lanes edgeCompliance;
+    Lanes volumeCompliance;
+    Lanes gravity;
+    Lanes floorY;
+    Lanes friction;                          // Coulomb friction coefficient against the floor
+
+    float dt = 1.f / 120;
+    int substeps = 10;
+    float sdt = dt / substeps;
+};
+
+#endif /* BATCHSOFTBODY_H */
@@ -4,6 +4,7 @@ SkinnedMesh::~SkinnedMesh() {}
 
 // load a mesh located at `mesh_path`. can optionally disable populating shader buffers.
 bool SkinnedMesh::loadMesh(std::string mesh_name, bool popBuffers) {
+    TRACE_SCOPE_CAT("SkinnedMesh::loadMesh", "load");
     populateBuffer = popBuffers;
     mesh_path = mesh_name;
 
@@ -78,6 +78,22 @@ public:
         return Util::sqDist(closest, p) <= radSqr;
     }
 
+    // could any part of the box be seen through `viewProjection`? a box is only rejected if it is entirely outside one of the frustum's planes,
+    // so some boxes near the frustum's corners are kept
+    bool inFrustum(const mat4& viewProjection) {
+        for (int i = 0; i < 6; ++i) {
+            // planes from the rows of the matrix, as w + x >= 0, w - x >= 0, and so on for y and z
+            int axis = i / 2;
+            float sign = i % 2 == 0 ? 1.f : -1.f;
+            vec4 plane;
+            for (int c = 0; c < 4; ++c) plane[c] = viewProjection[c][3] + sign * viewProjection[c][axis];
+            // the corner furthest along the plane's normal
+            vec3 p = vec3(plane.x >= 0 ? high.x : low.x, plane.y >= 0 ? high.y : low.y, plane.z >= 0 ? high.z : low.z);
+            if (dot(vec3(plane), p) + plane.w < 0) return false;
+        }
+        return true;
+    }
+
     // give the box a point. if the point is outside the box's bounds, the box will grow to include the point. returns true if the box grew
     bool grow(vec3 p) {
         if (contains(p)) return false;
@@ -0,0 +1,115 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <bit>
+#include <execution>
+#include <numeric>
+
+// spread the lower 10 bits of `v` so there are two zero bits between each
+static unsigned int expandBits(unsigned int v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+unsigned int BVH::morton3D(vec3 p) {
+    p = clamp(p * 1024.f, vec3(0), vec3(1023));
+    return (expandBits(p.x) << 2) | (expandBits(p.y) << 1) | expandBits(p.z);
+}
+
+void BVH::build(const std::vector<AABB>& boxes) {
+    TRACE_SCOPE_CAT("BVH::build", "load");
+    int n = boxes.size();
+    leafCount = n;
+    nodes.assign(std::max(2 * n - 1, 0), Node());
+    parents.assign(nodes.size(), -1);
+    leafOrder.resize(n);
+    visits.assign(std::max(n - 1, 0), 0);
+    if (n == 0) return;
+
+    // sort primitives along a Morton curve through the centroids. the primitive index in the low bits makes every key unique
+    AABB centroids;
+    for (const auto& b : boxes) centroids.grow(b.centre());
+    vec3 extent = max(centroids.high - centroids.low, vec3(1e-12f));
+    std::vector<unsigned long long> keys(n);
+    leafIndices.resize(n);
+    std::iota(leafIndices.begin(), leafIndices.end(), 0);
+    const std::vector<int>& idx = leafIndices;
+    std::for_each(std::execution::par, idx.begin(), idx.end(), [&](int i) {
+        unsigned long long code = morton3D((boxes[i].centre() - centroids.low) / extent);
+        keys[i] = (code << 32) | (unsigned int)i;
+    });
+    std::sort(std::execution::par, keys.begin(), keys.end());
+
+    int internal = n - 1;
+    std::for_each(std::execution::par, idx.begin(), idx.end(), [&](int i) {
+        int prim = keys[i] & 0xFFFFFFFF;
+        leafOrder[i] = prim;
+        nodes[internal + i].box = boxes[prim];
+        nodes[internal + i].left = prim;
+    });
+
+    // length of the common prefix of keys `i` and `j`, or -1 if `j` is out of range
+    auto delta = [&](int i, int j) {
+        if (j < 0 || j >= n) return -1;
+        return std::countl_zero(keys[i] ^ keys[j]);
+    };
+
+    // emit each internal node from the range of keys it covers
+    std::for_each(std::execution::par, idx.begin(), idx.end() - 1, [&](int i) {
+        // direction of the range, towards the neighbour sharing the longer prefix
+        int d = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+        int deltaMin = delta(i, i - d);
+
+        // upper bound for the range length, then binary search for the other end
+        int lMax = 2;
+        while (delta(i, i + lMax * d) > deltaMin) lMax *= 2;
+        int l = 0;
+        for (int t = lMax / 2; t >= 1; t /= 2) {
+            if (delta(i, i + (l + t) * d) > deltaMin) l += t;
+        }
+        int j = i + l * d;
+
+        // binary search for the split position, where the keys' common prefix ends
+        int deltaNode = delta(i, j);
+        int s = 0;
+        for (int div = 2, t = (l + 1) / 2; t >= 1; div *= 2, t = (l + div - 1) / div) {
+            if (delta(i, i + (s + t) * d) > deltaNode) s += t;
+            if (t == 1) break;
+        }
+        int split = i + s * d + std::min(d, 0);
+
+        int left = std::min(i, j) == split ? internal + split : split;
+        int right = std::max(i, j) == split + 1 ? internal + split + 1 : split + 1;
+        nodes[i].left = left;
+        nodes[i].right = right;
+        parents[left] = i;
+        parents[right] = i;
+    });
+
+    refit(boxes);
+}
+
+void BVH::refit(const std::vector<AABB>& boxes) {
+    TRACE_SCOPE_CAT("BVH::refit", "sim");
+    int n = leafCount;
+    if (n == 0) return;
+    int internal = n - 1;
+    std::fill(visits.begin(), visits.end(), 0);
+
+    // every leaf walks up towards the root. the first child to arrive at a node stops, and the second (which sees both children done) merges them
+    std::for_each(std::execution::par, leafIndices.begin(), leafIndices.end(), [&](int i) {
+        int node = internal + i;
+        nodes[node].box = boxes[leafOrder[i]];
+        int parent = parents[node];
+        while (parent >= 0) {
+            if (std::atomic_ref<int>(visits[parent]).fetch_add(1, std::memory_order_acq_rel) == 0) return;
+            AABB box = nodes[nodes[parent].left].box;
+            box.grow(nodes[nodes[parent].right].box);
+            nodes[parent].box = box;
+            parent = parents[parent];
+        }
+    });
+}
@@ -0,0 +1,158 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <atomic>
+#include <cfloat>
+#include <vector>
+
+#include "box.h"
+#include "util.h"
+
+#define BVH_STACK_SIZE 128  // traversal stack size. LBVHs over 64-bit keys are at most 64 levels deep
+
+// Linear bounding volume hierarchy (Karras 2012) over arbitrary primitives given by their bounding boxes.
+// Building sorts primitives along a Morton curve and emits every internal node independently, so both steps run in parallel.
+// Internal nodes are stored at [0, n - 1) with the root at 0, and leaves at [n - 1, 2n - 1).
+// `refit` recomputes the bounds bottom-up without changing the topology, for primitives that move but stay topologically close.
+class BVH {
+   public:
+    // Axis-aligned bounding box. A light-weight version of `Box` for storing in nodes
+    struct AABB {
+        vec3 low = vec3(FLT_MAX);
+        vec3 high = vec3(-FLT_MAX);
+        AABB() {}
+        AABB(vec3 l, vec3 h) : low(l), high(h) {}
+        void grow(vec3 p) {
+            low = min(low, p);
+            high = max(high, p);
+        }
+        void grow(const AABB& b) {
+            low = min(low, b.low);
+            high = max(high, b.high);
+        }
+        vec3 centre() const { return (low + high) * 0.5f; }
+        bool contains(vec3 p) const {
+            return p.x <= high.x && p.x >= low.x &&
+                   p.y <= high.y && p.y >= low.y &&
+                   p.z <= high.z && p.z >= low.z;
+        }
+        // squared distance from `p` to the closest point of the box. 0 if inside
+        float sqDist(vec3 p) const { return Util::sqDist(p, clamp(p, low, high)); }
+        // does the ray `o + t * d` (with `invD = 1 / d`) hit the box for some t in [0, tMax]?
+        bool intersects(vec3 o, vec3 invD, float tMax) const {
+            vec3 t0 = (low - o) * invD;
+            vec3 t1 = (high - o) * invD;
+            vec3 tNear = min(t0, t1), tFar = max(t0, t1);
+            float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+            float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+            return tEnter <= tExit;
+        }
+        Box toBox() const { return Box(low, high); }
+    };
+
+    struct Node {
+        AABB box;
+        int left = -1;   // left child node, or primitive index for leaves
+        int right = -1;  // right child node, or -1 for leaves
+    };
+
+    // 30-bit Morton code of `p`, which must be in [0, 1]^3
+    static unsigned int morton3D(vec3 p);
+    // Build the hierarchy over primitives with bounding boxes `boxes`
+    void build(const std::vector<AABB>& boxes);
+    // Recompute node bounds from the primitives' new `boxes`, keeping the hierarchy built by `build()`
+    void refit(const std::vector<AABB>& boxes);
+
+    int root() const { return 0; }
+    bool isLeaf(int node) const { return node >= leafCount - 1; }
+    bool empty() const { return leafCount == 0; }
+    // bounds of the whole hierarchy
+    Box bounds() const { return empty() ? Box() : nodes[root()].box.toBox(); }
+
+    // Call `leaf(prim)` for every primitive whose bounds satisfy `overlaps(box)`, visiting only subtrees whose bounds satisfy it
+    template <typename Overlaps, typename Leaf>
+    void traverse(Overlaps overlaps, Leaf leaf) const {
+        if (empty()) return;
+        int stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = root();
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!overlaps(node.box)) continue;
+            if (node.right < 0) {
+                leaf(node.left);
+            } else {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+    }
+
+    // Call `leaf(prim)` for every primitive whose bounds contain `p`. `leaf` can return true to stop early
+    template <typename Leaf>
+    void queryPoint(vec3 p, Leaf leaf) const {
+        bool done = false;
+        traverse([&](const AABB& b) { return !done && b.contains(p); },
+                 [&](int prim) { done = leaf(prim); });
+    }
+
+    // Find the primitive closest to `p`, where `sqDist(prim, p)` gives the squared distance to a primitive.
+    // Closer subtrees are visited first and subtrees further than the best so far are skipped. Returns -1 if empty
+    template <typename SqDist>
+    int nearest(vec3 p, SqDist sqDist, float* outSqDist = nullptr) const {
+        int best = -1;
+        float bestDist = FLT_MAX;
+        if (empty()) return best;
+        int stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = root();
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.box.sqDist(p) >= bestDist) continue;
+            if (node.right < 0) {
+                float d = sqDist(node.left, p);
+                if (d < bestDist) {
+                    bestDist = d;
+                    best = node.left;
+                }
+                continue;
+            }
+            // push the further child first, so the closer one is visited next
+            float dl = nodes[node.left].box.sqDist(p);
+            float dr = nodes[node.right].box.sqDist(p);
+            if (dl < dr) {
+                stack[top++] = node.right;
+                stack[top++] = node.left;
+            } else {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+        if (outSqDist) *outSqDist = bestDist;
+        return best;
+    }
+
+    // Find the closest primitive hit by the ray `o + t * d` with t in [0, `tMax`], where `hit(prim, tMax)` tests a primitive and, on a closer hit, lowers `tMax` and returns true.
+    // Returns the primitive hit, or -1. `tMax` is left at the hit distance
+    template <typename Hit>
+    int raycast(vec3 o, vec3 d, float& tMax, Hit hit) const {
+        int best = -1;
+        vec3 invD = 1.f / d;
+        traverse([&](const AABB& b) { return b.intersects(o, invD, tMax); },
+                 [&](int prim) {
+                     if (hit(prim, tMax)) best = prim;
+                 });
+        return best;
+    }
+
+    std::vector<Node> nodes;       // internal nodes followed by leaves
+    std::vector<int> parents;      // parent of each node (-1 for the root)
+    std::vector<int> leafOrder;    // primitive stored in each leaf
+    int leafCount = 0;
+
+   private:
+    std::vector<int> visits;       // children finished per internal node, updated atomically by `refit`
+    std::vector<int> leafIndices;  // 0, 1, ..., n - 1, for parallel loops over leaves
+};
+
+#endif /* BVH_H */
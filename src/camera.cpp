@@ -93,3 +93,11 @@ void Camera::setPosition(vec3 p) {
     followPos = p;
     processView(0, 0);
 }
+
+void Camera::screenRay(vec2 ndc, vec3& origin, vec3& dir) {
+    mat4 inv = inverse(perspectiveProjection * view);
+    vec4 n = inv * vec4(ndc, -1.f, 1.f);
+    vec4 f = inv * vec4(ndc, 1.f, 1.f);
+    origin = vec3(n) / n.w;
+    dir = normalize(vec3(f) / f.w - origin);
+}
@@ -53,6 +53,9 @@ class Camera {
     // Get the perspective projection matrix for the camera.
     mat4 getPerspectiveMatrix() { return perspectiveProjection; }
 
+    // Get the world-space ray through the screen point `ndc` (normalised device coords, y up), starting on the near plane
+    void screenRay(vec2 ndc, vec3& origin, vec3& dir);
+
     // Variables
     vec3 pos = vec3(0.0f);           // Camera position
     vec3 followPos = vec3(0.0f);     // Camera follow position; used for interpolated movement
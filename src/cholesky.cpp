@@ -0,0 +1,151 @@
+#include "cholesky.h"
+
+#include <numeric>
+
+// row of lowest degree in the last breadth-first level from `start`. repeating this from its own result finds a row near the edge of the graph
+static int farthestRow(int start, const std::vector<int>& adjOffsets, const std::vector<int>& adj, std::vector<int>& seen, int stamp, std::vector<int>& queue) {
+    auto degree = [&](int i) { return adjOffsets[i + 1] - adjOffsets[i]; };
+    queue.assign(1, start);
+    seen[start] = stamp;
+    size_t levelStart = 0;
+    while (true) {
+        size_t levelEnd = queue.size();
+        for (size_t q = levelStart; q < levelEnd; ++q) {
+            for (int k = adjOffsets[queue[q]]; k < adjOffsets[queue[q] + 1]; ++k) {
+                if (seen[adj[k]] == stamp) continue;
+                seen[adj[k]] = stamp;
+                queue.push_back(adj[k]);
+            }
+        }
+        if (queue.size() == levelEnd) break;
+        levelStart = levelEnd;
+    }
+    int best = queue[levelStart];
+    for (size_t q = levelStart; q < queue.size(); ++q) {
+        if (degree(queue[q]) < degree(best)) best = queue[q];
+    }
+    return best;
+}
+
+// reverse Cuthill-McKee: breadth-first from a peripheral row of each connected component, visiting neighbours by increasing degree, then reversed
+static void reverseCuthillMcKee(int n, const std::vector<int>& adjOffsets, const std::vector<int>& adj, std::vector<int>& order) {
+    auto degree = [&](int i) { return adjOffsets[i + 1] - adjOffsets[i]; };
+    std::vector<int> byDegree(n);
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) { return degree(a) < degree(b); });
+    std::vector<char> visited(n, 0);
+    std::vector<int> seen(n, -1), queue, next;
+    int stamp = 0;
+    order.clear();
+    order.reserve(n);
+    for (int s : byDegree) {
+        if (visited[s]) continue;
+        int start = s;
+        for (int k = 0; k < 2; ++k) start = farthestRow(start, adjOffsets, adj, seen, stamp++, queue);
+        size_t q = order.size();
+        order.push_back(start);
+        visited[start] = 1;
+        while (q < order.size()) {
+            int i = order[q++];
+            next.clear();
+            for (int k = adjOffsets[i]; k < adjOffsets[i + 1]; ++k) {
+                if (visited[adj[k]]) continue;
+                visited[adj[k]] = 1;
+                next.push_back(adj[k]);
+            }
+            std::sort(next.begin(), next.end(), [&](int a, int b) { return degree(a) < degree(b); });
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+}
+
+void SkylineCholesky::clear() {
+    n = 0;
+    order.clear();
+    rank.clear();
+    first.clear();
+    offsets.clear();
+    values.clear();
+}
+
+bool SkylineCholesky::factor(int size, const std::vector<std::tuple<int, int, double>>& entries) {
+    clear();
+    n = size;
+
+    // symmetric adjacency of the off-diagonal entries, for the ordering
+    std::vector<std::pair<int, int>> pairs;
+    pairs.reserve(entries.size() * 2);
+    for (const auto& [r, c, v] : entries) {
+        if (r == c) continue;
+        pairs.push_back({r, c});
+        pairs.push_back({c, r});
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    std::vector<int> adjOffsets(n + 1, 0), adj(pairs.size());
+    for (const auto& p : pairs) adjOffsets[p.first + 1]++;
+    std::inclusive_scan(adjOffsets.begin(), adjOffsets.end(), adjOffsets.begin());
+    for (size_t k = 0; k < pairs.size(); ++k) adj[k] = pairs[k].second;
+
+    reverseCuthillMcKee(n, adjOffsets, adj, order);
+    rank.resize(n);
+    for (int i = 0; i < n; ++i) rank[order[i]] = i;
+
+    // skyline of the reordered lower triangle
+    first.resize(n);
+    std::iota(first.begin(), first.end(), 0);
+    for (const auto& p : pairs) {
+        int a = rank[p.first], b = rank[p.second];
+        if (b < a) first[a] = std::min(first[a], b);
+    }
+    offsets.assign(n + 1, 0);
+    for (int i = 0; i < n; ++i) offsets[i + 1] = offsets[i] + (i - first[i] + 1);
+    values.assign(offsets[n], 0);
+    auto at = [&](int i, int j) { return offsets[i] + (j - first[i]); };
+    for (const auto& [r, c, v] : entries) {
+        int a = rank[r], b = rank[c];
+        if (a < b) std::swap(a, b);
+        values[at(a, b)] += v;
+    }
+
+    // row by row: each entry of L is its entry of A minus the dot product of the two rows' overlapping parts, which are contiguous
+    for (int i = 0; i < n; ++i) {
+        for (int j = first[i]; j < i; ++j) {
+            int k0 = std::max(first[i], first[j]);
+            const double* a = &values[at(i, k0)];
+            const double* b = &values[at(j, k0)];
+            double s = values[at(i, j)];
+            for (int k = 0; k < j - k0; ++k) s -= a[k] * b[k];
+            values[at(i, j)] = s / values[at(j, j)];
+        }
+        const double* row = &values[at(i, first[i])];
+        double d = values[at(i, i)];
+        for (int k = 0; k < i - first[i]; ++k) d -= row[k] * row[k];
+        if (!(d > 0)) {
+            clear();
+            return false;
+        }
+        values[at(i, i)] = std::sqrt(d);
+    }
+    return true;
+}
+
+void SkylineCholesky::solve(double* b) const {
+    std::vector<double> y(n);
+    for (int i = 0; i < n; ++i) y[i] = b[order[i]];
+    // L y = b, reading each row of L
+    for (int i = 0; i < n; ++i) {
+        const double* row = &values[offsets[i]];
+        double s = y[i];
+        for (int j = first[i]; j < i; ++j) s -= row[j - first[i]] * y[j];
+        y[i] = s / row[i - first[i]];
+    }
+    // L^T x = y, subtracting each solved value from the rows above it
+    for (int i = n - 1; i >= 0; --i) {
+        const double* row = &values[offsets[i]];
+        y[i] /= row[i - first[i]];
+        for (int j = first[i]; j < i; ++j) y[j] -= row[j - first[i]] * y[i];
+    }
+    for (int i = 0; i < n; ++i) b[order[i]] = y[i];
+}
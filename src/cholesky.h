@@ -0,0 +1,32 @@
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+// Sparse Cholesky factorisation (A = L L^T) of a symmetric positive definite matrix, stored as a skyline: each row of L is kept from its first
+// non-zero column to the diagonal, which is also where all of its fill-in lands. Rows are reordered with reverse Cuthill-McKee first, which keeps
+// the non-zeros of mesh-like matrices close to the diagonal, so the skyline stays narrow.
+// Factoring costs O(n * bandwidth^2) and is done once; every solve after that is a forward and a back substitution over contiguous rows.
+class SkylineCholesky {
+   public:
+    // Factor the `n` x `n` matrix with the given (row, column, value) entries. Each off-diagonal pair is given once, in either triangle,
+    // and entries at the same position are summed. Returns false if the matrix is not positive definite
+    bool factor(int n, const std::vector<std::tuple<int, int, double>>& entries);
+    // Solve A x = b, overwriting `b` (`n` values) with x
+    void solve(double* b) const;
+
+    bool empty() const { return n == 0; }
+    void clear();
+
+    int n = 0;
+    std::vector<int> order;       // original row of each reordered row
+    std::vector<int> rank;        // reordered row of each original row
+    std::vector<int> first;       // first stored column of each reordered row
+    std::vector<size_t> offsets;  // start of each reordered row in `values`
+    std::vector<double> values;   // rows of L, each from `first[i]` to the diagonal
+};
+
+#endif /* CHOLESKY_H */
@@ -0,0 +1,57 @@
+#include "gputimer.h"
+
+GPUTimer::GPUTimer() {
+    GLint bits = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+    supported = bits > 0;
+    if (!supported) {
+        printf("GL_TIME_ELAPSED queries are not supported, GPU timings are disabled\n");
+        return;
+    }
+    for (auto& frame : queries) {
+        for (auto& q : frame) glGenQueries(1, &q.id);
+    }
+}
+
+GPUTimer::~GPUTimer() {
+    if (!supported) return;
+    for (auto& frame : queries) {
+        for (auto& q : frame) glDeleteQueries(1, &q.id);
+    }
+}
+
+void GPUTimer::begin(Profiler::Channel ch) {
+    if (!supported || active >= 0) return;
+    Query& q = queries[Profiler::frameCount % PROFILER_GPU_LATENCY][ch];
+    if (q.pending) tryRead(q, ch);
+    if (q.pending) return;  // GPU is more than `PROFILER_GPU_LATENCY` frames behind. skip rather than wait
+    glBeginQuery(GL_TIME_ELAPSED, q.id);
+    q.frame = Profiler::frameCount;
+    active = ch;
+}
+
+void GPUTimer::end() {
+    if (active < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    queries[Profiler::frameCount % PROFILER_GPU_LATENCY][active].pending = true;
+    active = -1;
+}
+
+void GPUTimer::collect() {
+    if (!supported) return;
+    for (auto& frame : queries) {
+        for (int ch = 0; ch < Profiler::CHANNEL_COUNT; ++ch) {
+            if (frame[ch].pending) tryRead(frame[ch], ch);
+        }
+    }
+}
+
+void GPUTimer::tryRead(Query& q, int ch) {
+    GLint available = 0;
+    glGetQueryObjectiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &ns);
+    Profiler::record((Profiler::Channel)ch, ns * 1e-6f, q.frame);
+    q.pending = false;
+}
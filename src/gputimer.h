@@ -0,0 +1,41 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/gl.h>
+
+#include <cstdio>
+
+#include "profiler.h"
+
+// Non-blocking GPU pass timer built on GL_TIME_ELAPSED queries.
+// Each profiler channel has one query for each of the last `PROFILER_GPU_LATENCY` frames, and results are only read back once the driver reports them available.
+// If a query is still busy when its slot comes round again, that pass goes untimed for the frame instead of stalling.
+// Requires an OpenGL context.
+class GPUTimer {
+   public:
+    GPUTimer();
+    ~GPUTimer();
+
+    // Start timing channel `ch`. Passes cannot be nested
+    void begin(Profiler::Channel ch);
+    // Stop timing the current pass
+    void end();
+    // Hand any finished results to the profiler. Call once per frame
+    void collect();
+
+    struct Query {
+        GLuint id = 0;
+        unsigned long frame = 0;  // profiler frame the query was issued in
+        bool pending = false;     // issued, but result not read back yet
+    };
+
+    bool supported = false;  // whether the implementation has a usable GL_TIME_ELAPSED counter
+    int active = -1;         // channel being timed, or -1
+    Query queries[PROFILER_GPU_LATENCY][Profiler::CHANNEL_COUNT];
+
+   private:
+    // read back `q` into channel `ch` if its result is available
+    void tryRead(Query& q, int ch);
+};
+
+#endif /* GPUTIMER_H */
@@ -3,6 +3,7 @@
 #include "main.h"
 
 void init() {
+    TRACE_SCOPE("init");
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(MessageCallback, 0);
@@ -18,6 +19,20 @@ void init() {
     sbShader = new Shader("softbody", vert_sbody, frag_sbody);
     sbLight = new Lighting("sb light", sbShader, MATERIAL_RUBBER);
     sb = new SoftBody("SoftBunny", MESH_SBUNNY);
+    sb->recomputeNormals = true;
+    sb->transform = translate(mat4(1), vec3(0, 10, -5));
+    cubeCollider = new SDFCollider(startMeshB, 0.05f, 4, translate(mat4(1), vec3(0, 5, -5)));
+    sb->colliders.push_back(cubeCollider);
+    sb2 = new SoftBody("SoftSphere", ProcMesh::sphere(8, 1));
+    sb2->transform = translate(mat4(1), vec3(0.5f, 14, -5));
+    sb2->colliders.push_back(cubeCollider);
+    sb->buildLODs(3);
+    sb2->buildLODs(2);
+    world = new PhysicsWorld();
+    world->add(sb);
+    world->add(sb2);
+    world->camera = SM::camera;
+    gpuTimer = new GPUTimer();
 
     // startLight->addSpotLightAtt(vec3(-20, -1, -5), Util::RIGHT, vec3(0.2f), vec3(1), vec3(1));
     startLight->addPointLightAtt(lightPos, vec3(0.2f), vec3(1), vec3(1));
@@ -29,6 +44,8 @@ void init() {
 }
 
 void display() {
+    PROFILE_SCOPE(Profiler::RENDER);
+    gpuTimer->collect();
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);  // enable depth-testing
     glEnable(GL_BLEND);       // enable colour blending
@@ -40,35 +57,49 @@ void display() {
     mat4 view = SM::camera->getViewMatrix();
     mat4 projection = SM::camera->getPerspectiveMatrix();
 
-    // startLight->use();
-    // startLight->setLightAtt(view, projection, SM::camera->pos);
-    // startLight->setPointLightAtt(0, lightPos);
-    // startMeshB->render(translate(mat4(1), vec3(0, 1, -5)));
+    startLight->use();
+    startLight->setLightAtt(view, projection, SM::camera->pos);
+    startLight->setPointLightAtt(0, lightPos);
+    startMeshB->render(cubeCollider->transform);
 
     sbLight->use();
     sbLight->setLightAtt(view, projection, SM::camera->pos);
     sbLight->setPointLightAtt(0, lightPos);
     sbLight->shader->setVec3("colour", vec3(1));
-    sb->mesh->render(translate(mat4(1), vec3(0, 10, -5)));
+    gpuTimer->begin(Profiler::GPU_SOFTBODY);
+    sb->render(sbShader, sb->transform);
+    sb2->render(sbShader, sb2->transform);
+    gpuTimer->end();
 
     lightShader->use();
     lightShader->setVec3("viewPos", SM::camera->pos);
     lightShader->setMat4("view", view);
     lightShader->setMat4("proj", projection);
     lightShader->setVec4("colour", vec4(1));
+    gpuTimer->begin(Profiler::GPU_LIGHT);
     lightMesh->render(translate(mat4(1), lightPos) * scale(mat4(1), vec3(0.25)));
+    gpuTimer->end();
 }
 
 void update() {
+    PROFILE_SCOPE(Profiler::UPDATE);
     SM::updateDelta();
     if (!SM::debug) {
         SM::camera->processMovement();
     }
-    sb->update();
+    sb2->gravity = sb->gravity;
+    sb2->friction = sb->friction;
+    sb2->restitution = sb->restitution;
+    // each floor is in its own body's space, so carry `sb`'s floor over at the same world height
+    float floorHeight = (sb->transform * vec4(0, sb->floorY, 0, 1)).y;
+    sb2->floorY = (inverse(sb2->transform) * vec4(0, floorHeight, 0, 1)).y;
+    world->updateLOD(vec3(inverse(SM::camera->view)[3]));
+    world->update();
     SM::updateTick();
 }
 
 void displayUI() {
+    PROFILE_SCOPE(Profiler::UI);
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -76,6 +107,7 @@ void displayUI() {
     auto io = ImGui::GetIO();
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
     ImGui::Text("MP: %.0f, %.0f", SM::mouse.x, SM::mouse.y);
+    Profiler::drawUI();
     // if (ImGui::SliderFloat3("Camera Position", &SM::camera->pos.x, -10, 10)) {
     //     SM::camera->updateViewMatrix();
     // }
@@ -84,9 +116,53 @@ void displayUI() {
     ImGui::SliderFloat("Edge Compliance", &sb->edgeCompliance, 0, 10);
     // ImGui::SliderFloat("Volume Compliance", &sb->volumeCompliance, 0, 1); // should stay at 0 for stability
     ImGui::SliderFloat("Floor Y", &sb->floorY, -50, 10);
+    ImGui::SliderFloat("Friction", &sb->friction, 0, 1);
+    ImGui::SliderFloat("Restitution", &sb->restitution, 0, 1);
+    ImGui::Checkbox("GPU Skinning", &sb->gpuSkinning);
+    ImGui::SameLine();
+    ImGui::BeginDisabled(sb->gpuSkinning);
+    ImGui::Checkbox("Recompute Normals", &sb->recomputeNormals);
+    ImGui::EndDisabled();
+    ImGui::Checkbox("Self-Collision", &sb->selfCollision);
+    ImGui::Text("Simulation LOD: %d (%d tetrahedra)", sb->lod, sb->tetraCount);
+    int backend = sb->backend;
+    if (ImGui::Combo("Solver", &backend, "XPBD\0Projective Dynamics\0FEM\0Shape Matching\0")) sb->backend = (SoftBody::SolverBackend)backend;
+    bool projective = sb->backend == SoftBody::PROJECTIVE_DYNAMICS;
+    if (projective) {
+        ImGui::SliderFloat("Stiffness", &sb->projectiveStiffness, 1e3f, 1e8f, "%.0e", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderInt("Projective Iterations", &sb->projectiveIterations, 1, 20);
+    } else if (sb->backend == SoftBody::FEM) {
+        ImGui::SliderFloat("Young's Modulus", &sb->youngsModulus, 1e1f, 1e6f, "%.0e", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Poisson Ratio", &sb->poissonRatio, 0, 0.49f);
+    } else if (sb->backend == SoftBody::SHAPE_MATCHING) {
+        ImGui::SliderFloat("Shape Stiffness", &sb->shapeStiffness, 0, 1);
+        if (ImGui::SliderFloat("Cluster Size", &sb->clusterSize, 0, 2)) sb->clusterOffsets.clear();
+    }
+    ImGui::BeginDisabled(projective || sb->backend == SoftBody::SHAPE_MATCHING);
+    ImGui::Checkbox("Multigrid Solver", &sb->multigrid);
+    ImGui::BeginDisabled(!sb->multigrid);
+    ImGui::SliderInt("Coarse Iterations", &sb->coarseIterations, 1, 10);
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    ImGui::BeginDisabled(sb->backend != SoftBody::XPBD);
+    ImGui::Checkbox("Partitioned Solver", &sb->partitioned);
+    ImGui::BeginDisabled(!sb->partitioned);
+    if (ImGui::SliderInt("Partition Size", &sb->partitionSize, 256, 16384, "%d", ImGuiSliderFlags_Logarithmic)) sb->partitionEdgeOffsets.clear();
+    ImGui::SliderInt("Partition Iterations", &sb->partitionIterations, 1, 8);
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    ImGui::Checkbox("Local Grab Relaxation", &sb->localGrab);
+    ImGui::BeginDisabled(!sb->localGrab);
+    ImGui::SliderInt("Grab Rings", &sb->grabRings, 1, 10);
+    ImGui::SliderInt("Grab Iterations", &sb->grabIterations, 1, 20);
+    ImGui::EndDisabled();
+    bool tracing = Trace::enabled;
+    if (ImGui::Checkbox("Record Trace (F9 to start, then save)", &tracing)) Trace::enabled = tracing;
     ImGui::End();
     ImGui::Render();
+    gpuTimer->begin(Profiler::GPU_UI);
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gpuTimer->end();
 }
 
 // key pressed
@@ -108,13 +184,34 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         if (key == 'D') SM::camera->RIGHT = action == GLFW_REPEAT || action == GLFW_PRESS;
         if (key == 'E') SM::camera->SPRINT = action == GLFW_REPEAT || action == GLFW_PRESS;
         if (key == 'P' && action == GLFW_PRESS) SM::camera->CAN_FLY = !SM::camera->CAN_FLY;
+        if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+            // the first press starts recording, the next ones save what has been recorded
+            if (Trace::enabled) Trace::exportJSON(PROJDIR "trace_" + std::to_string(SM::tick) + ".json");
+            else Trace::enabled = true;
+        }
     }
 }
 
+// world-space ray under the cursor at window position (`x`, `y`)
+void cursorRay(GLFWwindow* window, double x, double y, vec3& origin, vec3& dir) {
+    int w, h;
+    glfwGetWindowSize(window, &w, &h);
+    SM::camera->screenRay(vec2(2 * x / w - 1, 1 - 2 * y / h), origin, dir);
+}
+
 // mouse clicked
 void click_callback(GLFWwindow* window, int button, int action, int mods) {
     ImGuiIO& io = ImGui::GetIO();
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) sb->releaseGrab();
     if (!io.WantCaptureMouse) {
+        // grab the soft body while the cursor is free
+        if (SM::debug && button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+            double x, y;
+            vec3 origin, dir;
+            glfwGetCursorPos(window, &x, &y);
+            cursorRay(window, x, y, origin, dir);
+            sb->grab(origin, dir);
+        }
     }
 }
 
@@ -124,6 +221,11 @@ void mouse_pos_callback(GLFWwindow* window, double nx, double ny) {
         if (!SM::debug) {
             SM::camera->processView(nx - SM::mouse.x, ny - SM::mouse.y);
         }
+    if (sb->grabbed >= 0) {
+        vec3 origin, dir;
+        cursorRay(window, nx, ny, origin, dir);
+        sb->moveGrab(origin, dir);
+    }
     if (SM::tick > 100) {
     }
     SM::updateMouse(nx, ny);
@@ -178,10 +280,16 @@ int main(int argc, char const* argv[]) {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init();
     // raise(SIGTRAP);
+    Trace::setThreadName("Main");
     init();
     // Main Loop
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        Profiler::beginFrame();
+        TRACE_SCOPE("frame");
+        {
+            PROFILE_SCOPE(Profiler::POLL);
+            glfwPollEvents();
+        }
         if (SM::debug) {
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
         } else {
@@ -190,8 +298,10 @@ int main(int argc, char const* argv[]) {
         update();
         display();
         displayUI();
+        PROFILE_SCOPE(Profiler::SWAP);
         glfwSwapBuffers(window);
     }
+    if (Trace::enabled) Trace::exportJSON(PROJDIR "trace.json");
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -18,13 +18,16 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "camera.h"
+#include "gputimer.h"
 #include "lighting.h"
+#include "profiler.h"
 #include "shader.h"
 #include "softbody.h"
 #include "sprite.h"
 #include "staticmesh.h"
 #include "bonemesh.h"
 #include "variantmesh.h"
+#include "world.h"
 #include "sm.h"
 #include "ui.h"
 #include "util.h"
@@ -52,7 +55,10 @@ const char* frag_blank = PROJDIR "Shaders/blank.frag";
 Shader* startShader, *lightShader, *sbShader;
 Lighting* startLight, *sbLight;
 StaticMesh *startMeshA, *startMeshB, *lightMesh;
-SoftBody* sb;
+SoftBody *sb, *sb2;
+PhysicsWorld* world;
+GPUTimer* gpuTimer;
+SDFCollider* cubeCollider;
 float radius = 1;
 vec3 lightPos = vec3(0, 20, -5);
 vec3 lightCol = vec3(0.2, 1, 1);
@@ -21,6 +21,7 @@
 #include "sm.h"
 #include "texture.h"
 #include "shader.h"
+#include "streambuffer.h"
 
 #define MAX_NUM_BONES_PER_VERTEX 4
 #define MAX_JOINTS_PER_BONE 16  // maximum number of children a bone can have
@@ -232,6 +233,8 @@ class Mesh {
     bool usingAtlas = false;                             // flag if the mesh is using an array texture
     bool populateBuffer = true;                          // should this mesh's buffers be populated?
     bool useCustomVertices = false;                      // will this mesh use custom vertices?
+    StreamBuffer* p_Stream = nullptr;                    // persistently mapped position stream, replaces p_vbo for custom vertices
+    StreamBuffer* n_Stream = nullptr;                    // persistently mapped normal stream, replaces n_vbo for custom vertices
     std::vector<vec3> vertices;                          // vertex positions
     std::vector<vec3> cVertices;                         // custom vertex positions
     std::vector<vec3> normals;                           // vertex normals
@@ -0,0 +1,328 @@
+#include <cfloat>
+#include <filesystem>
+
+#include "procmesh.h"
+
+namespace ProcMesh {
+
+// axis orders used to split a cell into 6 tetrahedra. a cell's tetrahedron `k` walks from its lowest to its highest corner
+// along the axes PERMS[k][0], PERMS[k][1], then PERMS[k][2]
+static const int PERMS[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+static const bool ODD[6] = {false, true, true, false, false, true};  // odd permutations produce inverted tetrahedra
+
+static const char* SHAPE_NAMES[3] = {"grid", "cube", "sphere"};
+
+// index of the tetrahedron that starts walking along axis `a`, then axis `b`
+static int permIndex(int a, int b) {
+    for (int k = 0; k < 6; ++k) {
+        if (PERMS[k][0] == a && PERMS[k][1] == b) return k;
+    }
+    return -1;
+}
+
+// unit lattice step along `axis`
+static ivec3 step(int axis) {
+    ivec3 s = ivec3(0);
+    s[axis] = 1;
+    return s;
+}
+
+// map a lattice coordinate `u` in [0, 1]^3 to a position on the shape
+static vec3 mapPoint(Shape shape, vec3 u, vec3 size) {
+    if (shape == SPHERE) {
+        // spherified cube; maps the unit cube onto the unit ball while keeping the lattice's topology
+        vec3 c = u * 2.f - 1.f;
+        vec3 c2 = c * c;
+        vec3 s = vec3(
+            c.x * sqrt(1 - c2.y / 2 - c2.z / 2 + c2.y * c2.z / 3),
+            c.y * sqrt(1 - c2.z / 2 - c2.x / 2 + c2.z * c2.x / 3),
+            c.z * sqrt(1 - c2.x / 2 - c2.y / 2 + c2.x * c2.y / 3));
+        float r = size.x / 2;
+        return s * r + vec3(0, r, 0);
+    }
+    return vec3((u.x - 0.5f) * size.x, u.y * size.y, (u.z - 0.5f) * size.z);
+}
+
+TetMesh generate(Shape shape, ivec3 cells, vec3 size, int surfaceRes) {
+    TetMesh tm;
+    cells = max(cells, ivec3(1));
+    surfaceRes = std::max(surfaceRes, 1);
+    if (shape == SPHERE) size = vec3(size.x);
+    tm.shape = shape;
+    tm.cells = cells;
+    tm.size = size;
+
+    ivec3 vdim = cells + 1;  // lattice vertices along each axis
+    int nv = vdim.x * vdim.y * vdim.z;
+    int nc = cells.x * cells.y * cells.z;
+    auto vIndex = [&](ivec3 v) { return v.x + vdim.x * (v.y + vdim.y * v.z); };
+    auto cIndex = [&](ivec3 c) { return c.x + cells.x * (c.y + cells.y * c.z); };
+
+    // vertices
+    std::vector<int> vIDs(nv);
+    std::iota(vIDs.begin(), vIDs.end(), 0);
+    tm.vertices.resize(nv);
+    std::for_each(std::execution::par, vIDs.begin(), vIDs.end(), [&](auto&& i) {
+        ivec3 v = ivec3(i % vdim.x, (i / vdim.x) % vdim.y, i / (vdim.x * vdim.y));
+        tm.vertices[i] = mapPoint(shape, vec3(v) / vec3(cells), size);
+    });
+
+    // tetrahedra and their face neighbours
+    std::vector<int> cIDs(nc);
+    std::iota(cIDs.begin(), cIDs.end(), 0);
+    tm.tetras.resize(nc * 6);
+    tm.neighbours.resize(nc * 6);
+    std::for_each(std::execution::par, cIDs.begin(), cIDs.end(), [&](auto&& c) {
+        ivec3 p = ivec3(c % cells.x, (c / cells.x) % cells.y, c / (cells.x * cells.y));
+        for (int k = 0; k < 6; ++k) {
+            int a = PERMS[k][0], b = PERMS[k][1], d = PERMS[k][2];
+            ivec3 p1 = p + step(a);
+            ivec3 p2 = p1 + step(b);
+            ivec4 t = ivec4(vIndex(p), vIndex(p1), vIndex(p2), vIndex(p + 1));
+
+            // the faces opposite corners 1 and 2 are shared within the cell. the faces opposite corners 0 and 3 are shared with the next cell along `a` and the previous cell along `d`
+            ivec4 n = ivec4(-1);
+            if (p[a] + 1 < cells[a]) n[0] = cIndex(p + step(a)) * 6 + permIndex(b, d);
+            n[1] = c * 6 + permIndex(b, a);
+            n[2] = c * 6 + permIndex(a, d);
+            if (p[d] > 0) n[3] = cIndex(p - step(d)) * 6 + permIndex(d, a);
+
+            // swap the first two corners (and their opposite faces) so every tetrahedron has a positive volume
+            if (ODD[k]) {
+                std::swap(t.x, t.y);
+                std::swap(n.x, n.y);
+            }
+            tm.tetras[c * 6 + k] = t;
+            tm.neighbours[c * 6 + k] = n;
+        }
+    });
+
+    // edges. every lattice vertex connects to the vertex along each of the 7 non-zero steps in {0, 1}^3, if it exists
+    int starts[8] = {0};
+    for (int d = 1; d <= 7; ++d) {
+        ivec3 ext = vdim - ivec3(d & 1, (d >> 1) & 1, (d >> 2) & 1);
+        starts[d] = starts[d - 1] + ext.x * ext.y * ext.z;
+    }
+    std::vector<int> eIDs(starts[7]);
+    std::iota(eIDs.begin(), eIDs.end(), 0);
+    tm.edges.resize(starts[7]);
+    std::for_each(std::execution::par, eIDs.begin(), eIDs.end(), [&](auto&& e) {
+        int d = 1;
+        while (e >= starts[d]) d++;
+        ivec3 dv = ivec3(d & 1, (d >> 1) & 1, (d >> 2) & 1);
+        ivec3 ext = vdim - dv;
+        int j = e - starts[d - 1];
+        ivec3 v = ivec3(j % ext.x, (j / ext.x) % ext.y, j / (ext.x * ext.y));
+        tm.edges[e] = ivec2(vIndex(v), vIndex(v + dv));
+    });
+
+    // surface. each face of the lattice is meshed separately so that corners keep sharp normals on boxes
+    vec3 centre = vec3(0, size.x / 2, 0);
+    for (int k = 0; k < 3; ++k) {
+        int a = (k + 1) % 3, b = (k + 2) % 3;
+        int na = cells[a] * surfaceRes, nb = cells[b] * surfaceRes;
+        for (int s = 0; s < 2; ++s) {
+            unsigned int base = tm.surfaceVertices.size();
+            for (int j = 0; j <= nb; ++j) {
+                for (int i = 0; i <= na; ++i) {
+                    vec3 u = vec3(0);
+                    u[k] = s;
+                    u[a] = (float)i / na;
+                    u[b] = (float)j / nb;
+                    vec3 p = mapPoint(shape, u, size);
+                    vec3 n = vec3(step(k)) * (s ? 1.f : -1.f);
+                    tm.surfaceVertices.push_back(p);
+                    tm.surfaceNormals.push_back(shape == SPHERE ? normalize(p - centre) : n);
+                    tm.surfaceTexCoords.push_back(vec2(u[a], u[b]));
+                }
+            }
+            for (int j = 0; j < nb; ++j) {
+                for (int i = 0; i < na; ++i) {
+                    unsigned int p00 = base + i + (na + 1) * j;
+                    unsigned int p10 = p00 + 1;
+                    unsigned int p01 = p00 + na + 1;
+                    unsigned int p11 = p01 + 1;
+                    if (s) {
+                        tm.surfaceIndices.insert(tm.surfaceIndices.end(), {p00, p10, p11, p00, p11, p01});
+                    } else {
+                        tm.surfaceIndices.insert(tm.surfaceIndices.end(), {p00, p11, p10, p00, p01, p11});
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Generated %s tetrahedral mesh (%d x %d x %d cells)\n", SHAPE_NAMES[shape], cells.x, cells.y, cells.z);
+    printf("%d vs, %d es, %d ts, %d surface vs\n", (int)tm.vertices.size(), (int)tm.edges.size(), (int)tm.tetras.size(), (int)tm.surfaceVertices.size());
+    return tm;
+}
+
+TetMesh cage(const std::vector<vec3>& vertices, const std::vector<ivec4>& tetras, float cellSize) {
+    TetMesh tm;
+    vec3 low = vec3(FLT_MAX), high = vec3(-FLT_MAX);
+    for (const auto& v : vertices) {
+        low = min(low, v);
+        high = max(high, v);
+    }
+    ivec3 cells = max(ivec3(ceil((high - low) / cellSize)), ivec3(1));
+    tm.shape = GRID;
+    tm.cells = cells;
+    tm.size = vec3(cells) * cellSize;
+
+    ivec3 vdim = cells + 1;
+    int nv = vdim.x * vdim.y * vdim.z;
+    int nc = cells.x * cells.y * cells.z;
+    auto vIndex = [&](ivec3 v) { return v.x + vdim.x * (v.y + vdim.y * v.z); };
+    auto cIndex = [&](ivec3 c) { return c.x + cells.x * (c.y + cells.y * c.z); };
+    auto cellOf = [&](vec3 p) { return clamp(ivec3(floor((p - low) / cellSize)), ivec3(0), cells - 1); };
+
+    // mark the cells overlapped by each tetrahedron's bounds
+    std::vector<char> occupied(nc, 0);
+    for (const auto& t : tetras) {
+        vec3 lo = vertices[t.x], hi = lo;
+        for (int k = 1; k < 4; ++k) {
+            lo = min(lo, vertices[t[k]]);
+            hi = max(hi, vertices[t[k]]);
+        }
+        ivec3 a = cellOf(lo), b = cellOf(hi);
+        for (int z = a.z; z <= b.z; ++z) {
+            for (int y = a.y; y <= b.y; ++y) {
+                for (int x = a.x; x <= b.x; ++x) occupied[cIndex(ivec3(x, y, z))] = 1;
+            }
+        }
+    }
+
+    // compact IDs for the occupied cells and the lattice vertices at their corners
+    std::vector<int> cellIDs(nc, -1), vertexIDs(nv, -1);
+    std::vector<ivec3> cellCoords;
+    std::vector<ivec3> vertexCoords;
+    for (int c = 0; c < nc; ++c) {
+        if (!occupied[c]) continue;
+        ivec3 p = ivec3(c % cells.x, (c / cells.x) % cells.y, c / (cells.x * cells.y));
+        cellIDs[c] = cellCoords.size();
+        cellCoords.push_back(p);
+        for (int s = 0; s < 8; ++s) {
+            ivec3 v = p + ivec3(s & 1, (s >> 1) & 1, (s >> 2) & 1);
+            int& id = vertexIDs[vIndex(v)];
+            if (id >= 0) continue;
+            id = vertexCoords.size();
+            vertexCoords.push_back(v);
+            tm.vertices.push_back(low + vec3(v) * cellSize);
+        }
+    }
+
+    // tetrahedra and their face neighbours, as in `generate`, with neighbours in unoccupied cells on the boundary
+    std::vector<int> cIDs(cellCoords.size());
+    std::iota(cIDs.begin(), cIDs.end(), 0);
+    tm.tetras.resize(cellCoords.size() * 6);
+    tm.neighbours.resize(cellCoords.size() * 6);
+    std::for_each(std::execution::par, cIDs.begin(), cIDs.end(), [&](auto&& c) {
+        ivec3 p = cellCoords[c];
+        for (int k = 0; k < 6; ++k) {
+            int a = PERMS[k][0], b = PERMS[k][1], d = PERMS[k][2];
+            ivec3 p1 = p + step(a);
+            ivec3 p2 = p1 + step(b);
+            ivec4 t = ivec4(vertexIDs[vIndex(p)], vertexIDs[vIndex(p1)], vertexIDs[vIndex(p2)], vertexIDs[vIndex(p + 1)]);
+
+            ivec4 n = ivec4(-1);
+            if (p[a] + 1 < cells[a] && cellIDs[cIndex(p + step(a))] >= 0) n[0] = cellIDs[cIndex(p + step(a))] * 6 + permIndex(b, d);
+            n[1] = c * 6 + permIndex(b, a);
+            n[2] = c * 6 + permIndex(a, d);
+            if (p[d] > 0 && cellIDs[cIndex(p - step(d))] >= 0) n[3] = cellIDs[cIndex(p - step(d))] * 6 + permIndex(d, a);
+
+            if (ODD[k]) {
+                std::swap(t.x, t.y);
+                std::swap(n.x, n.y);
+            }
+            tm.tetras[c * 6 + k] = t;
+            tm.neighbours[c * 6 + k] = n;
+        }
+    });
+
+    // edges. a cell's tetrahedra connect each corner `p + s` to the corners `p + s + d` with `s` and `d` disjoint in {0, 1}^3,
+    // so the edge from lattice vertex `v` along step `d` exists if any cell `v - s` with `s & d == 0` is occupied
+    for (int i = 0; i < (int)vertexCoords.size(); ++i) {
+        ivec3 v = vertexCoords[i];
+        for (int d = 1; d <= 7; ++d) {
+            ivec3 dv = ivec3(d & 1, (d >> 1) & 1, (d >> 2) & 1);
+            for (int s = 0; s < 8; ++s) {
+                if (s & d) continue;
+                ivec3 p = v - ivec3(s & 1, (s >> 1) & 1, (s >> 2) & 1);
+                if (min(min(p.x, p.y), p.z) < 0 || p.x >= cells.x || p.y >= cells.y || p.z >= cells.z || !occupied[cIndex(p)]) continue;
+                tm.edges.push_back(ivec2(i, vertexIDs[vIndex(v + dv)]));
+                break;
+            }
+        }
+    }
+
+    printf("Generated cage tetrahedral mesh (%d of %d x %d x %d cells)\n", (int)cellCoords.size(), cells.x, cells.y, cells.z);
+    printf("%d vs, %d es, %d ts\n", (int)tm.vertices.size(), (int)tm.edges.size(), (int)tm.tetras.size());
+    return tm;
+}
+
+TetMesh grid(ivec3 cells, vec3 size, int surfaceRes) {
+    return generate(GRID, cells, size, surfaceRes);
+}
+
+TetMesh cube(int subdivisions, float size, int surfaceRes) {
+    return generate(CUBE, ivec3(subdivisions), vec3(size), surfaceRes);
+}
+
+TetMesh sphere(int subdivisions, float radius, int surfaceRes) {
+    return generate(SPHERE, ivec3(subdivisions), vec3(radius * 2), surfaceRes);
+}
+
+int subdivisionsFor(long long tetraCount) {
+    return std::max(1, (int)std::round(std::cbrt(tetraCount / 6.0)));
+}
+
+StaticMesh* buildSurfaceMesh(const TetMesh& tm, std::string name, bool populate) {
+    StaticMesh* mesh = new StaticMesh();
+    mesh->name = name;  // mesh_path stays empty, as there is no file behind it
+    mesh->populateBuffer = populate;
+    mesh->vertices = tm.surfaceVertices;
+    mesh->normals = tm.surfaceNormals;
+    mesh->texCoords = tm.surfaceTexCoords;
+    mesh->indices = tm.surfaceIndices;
+    mesh->meshes.resize(1);
+    mesh->meshes[0].n_Indices = tm.surfaceIndices.size();
+    mesh->materials.resize(1);  // untextured
+    if (populate) {
+        mesh->populateBuffers();
+        glBindVertexArray(0);  // avoid modifying VAO between loads
+    }
+    return mesh;
+}
+
+bool writeTetraFile(const TetMesh& tm, std::string path) {
+    std::filesystem::path p(path);
+    if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        std::cout << "Failed to open file " << path << std::endl;
+        return false;
+    }
+
+    // boundary faces are the faces without a neighbouring tetrahedron
+    std::vector<ivec3> faces;
+    for (int t = 0; t < tm.tetras.size(); ++t) {
+        const ivec4& tet = tm.tetras[t];
+        for (int i = 0; i < 4; ++i) {
+            if (tm.neighbours[t][i] != -1) continue;
+            faces.push_back(ivec3(tet[(i + 1) % 4], tet[(i + 2) % 4], tet[(i + 3) % 4]));
+        }
+    }
+
+    fprintf(file, "vc %d\nec %d\nfc %d\ntc %d\ntnc %d\n\n",
+            (int)tm.vertices.size(), (int)tm.edges.size(), (int)faces.size(), (int)tm.tetras.size(), (int)tm.neighbours.size());
+    for (const auto& v : tm.vertices) fprintf(file, "v %.9g %.9g %.9g\n", v.x, v.y, v.z);
+    for (const auto& e : tm.edges) fprintf(file, "e %d %d\n", e.x, e.y);
+    for (const auto& f : faces) fprintf(file, "f %d %d %d\n", f.x, f.y, f.z);
+    for (const auto& t : tm.tetras) fprintf(file, "t %d %d %d %d\n", t.x, t.y, t.z, t.w);
+    for (const auto& n : tm.neighbours) fprintf(file, "tn %d %d %d %d\n", n.x, n.y, n.z, n.w);
+    fclose(file);
+    printf("Saved tetrahedral mesh \"%s\"\n", path.c_str());
+    return true;
+}
+
+}  // namespace ProcMesh
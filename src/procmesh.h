@@ -0,0 +1,56 @@
+#ifndef PROCMESH_H
+#define PROCMESH_H
+
+#include <execution>
+#include <numeric>
+
+#include "util.h"
+#include "staticmesh.h"
+
+// Procedural tetrahedral mesh generator. Used to create soft bodies of any size without needing a TetGen export, e.g., for scaling benchmarks.
+// Every shape is a lattice of cells, each split into 6 tetrahedra around the cell's main diagonal (Kuhn/Freudenthal subdivision), so the
+// topology (edges, tetrahedra, and face neighbours) is known analytically and can be generated in parallel.
+// Generated shapes rest on the plane y = 0 and are centred on the x and z axes.
+namespace ProcMesh {
+
+enum Shape {
+    GRID,    // box of `cells` cells with dimensions `size`
+    CUBE,    // box with the same number of cells along each axis
+    SPHERE   // cube lattice mapped onto a ball with diameter `size.x`
+};
+
+// Tetrahedral topology and a matching surface mesh
+struct TetMesh {
+    Shape shape = GRID;
+    ivec3 cells = ivec3(0);                   // number of cells along each axis
+    vec3 size = vec3(0);                      // dimensions of the shape
+    std::vector<vec3> vertices;               // tetrahedral mesh vertex positions
+    std::vector<ivec2> edges;                 // unique tetrahedral edges
+    std::vector<ivec4> tetras;                // tetrahedra, positively oriented
+    std::vector<ivec4> neighbours;            // tetrahedron sharing the face opposite each corner (-1 on the boundary), as in TetGen's .neigh files
+    std::vector<vec3> surfaceVertices;        // visual mesh vertex positions
+    std::vector<vec3> surfaceNormals;         // visual mesh vertex normals
+    std::vector<vec2> surfaceTexCoords;       // visual mesh texture coordinates (per face of the lattice)
+    std::vector<unsigned int> surfaceIndices; // visual mesh triangles
+};
+
+// Generate a shape. Each cell of the surface is divided into `surfaceRes` * `surfaceRes` quads, so the visual mesh can be denser than the tetrahedral mesh
+extern TetMesh generate(Shape shape, ivec3 cells, vec3 size, int surfaceRes = 1);
+// Generate a box with dimensions `size` made of `cells` cells
+extern TetMesh grid(ivec3 cells, vec3 size, int surfaceRes = 1);
+// Generate a cube with side length `size`, made of `subdivisions`^3 cells
+extern TetMesh cube(int subdivisions, float size, int surfaceRes = 1);
+// Generate a ball with radius `radius`, made of `subdivisions`^3 cells
+extern TetMesh sphere(int subdivisions, float radius, int surfaceRes = 1);
+// Generate the cells of size `cellSize` that overlap the tetrahedra of another mesh, as a coarser stand-in for it.
+// The cells cover every tetrahedron, so each of the mesh's vertices lies inside the result. No surface is generated
+extern TetMesh cage(const std::vector<vec3>& vertices, const std::vector<ivec4>& tetras, float cellSize);
+// Number of subdivisions (per axis) needed for a cube or sphere to have roughly `tetraCount` tetrahedra
+extern int subdivisionsFor(long long tetraCount);
+// Create a static mesh from the surface of a generated shape. Buffers are only populated if `populate` is set (requires an OpenGL context)
+extern StaticMesh* buildSurfaceMesh(const TetMesh& tm, std::string name, bool populate = true);
+// Write a generated shape to `path` in the .tetra format read by `SoftBody::loadTetraFile`
+extern bool writeTetraFile(const TetMesh& tm, std::string path);
+};  // namespace ProcMesh
+
+#endif /* PROCMESH_H */
@@ -0,0 +1,133 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+#include "imgui/imgui.h"
+
+namespace Profiler {
+
+const char* channelNames[CHANNEL_COUNT] = {"Frame", "Poll Events", "Update", "Render", "UI", "Swap Buffers", "GPU Soft Body", "GPU Light", "GPU UI"};
+
+float budgetMs = 1000.f / 60;
+unsigned long frameCount = 0;
+unsigned long overrunCount = 0;
+std::vector<Overrun> overruns;
+Overrun worstOverrun = {0, 0, FRAME, 0};
+
+static float history[CHANNEL_COUNT][PROFILER_HISTORY] = {};  // ring buffers of per-frame times. slot `frameCount % PROFILER_HISTORY` is the frame in progress
+static bool started = false;
+static std::chrono::steady_clock::time_point frameStart;
+
+void beginFrame() {
+    auto now = std::chrono::steady_clock::now();
+    if (started) {
+        int slot = frameCount % PROFILER_HISTORY;
+        float frameMs = std::chrono::duration<float, std::milli>(now - frameStart).count();
+        history[FRAME][slot] = frameMs;
+        if (frameMs > budgetMs) {
+            // blame the slowest CPU phase of the frame. GPU timings overlap them and have not arrived yet
+            Overrun o = {frameCount, frameMs, FRAME, 0};
+            for (int ch = FRAME + 1; ch < GPU_FIRST; ++ch) {
+                if (history[ch][slot] > o.phaseMs) {
+                    o.phase = (Channel)ch;
+                    o.phaseMs = history[ch][slot];
+                }
+            }
+            if (overruns.size() == PROFILER_OVERRUNS) overruns.erase(overruns.begin());
+            overruns.push_back(o);
+            if (o.frameMs > worstOverrun.frameMs) worstOverrun = o;
+            ++overrunCount;
+        }
+        ++frameCount;
+    }
+    started = true;
+    frameStart = now;
+    int slot = frameCount % PROFILER_HISTORY;
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) history[ch][slot] = 0;
+}
+
+void record(Channel ch, float ms) {
+    history[ch][frameCount % PROFILER_HISTORY] += ms;
+}
+
+void record(Channel ch, float ms, unsigned long frame) {
+    if (frame > frameCount || frameCount - frame >= PROFILER_HISTORY - 1) return;
+    history[ch][frame % PROFILER_HISTORY] = ms;
+}
+
+float get(Channel ch, int age) {
+    if (age < 0 || age >= PROFILER_HISTORY - 1 || (unsigned long)age >= frameCount) return 0;
+    return history[ch][(frameCount - 1 - age) % PROFILER_HISTORY];
+}
+
+// frame times oldest to newest, for plotting
+static float frameGetter(void* data, int idx) {
+    int n = *(int*)data;
+    return get(FRAME, n - 1 - idx);
+}
+
+void drawUI() {
+    if (!ImGui::CollapsingHeader("Frame Timings")) return;
+    ImGui::SliderFloat("Budget (ms)", &budgetMs, 1, 50, "%.2f");
+
+    // completed frames in the history, excluding the one in progress
+    int n = std::min<unsigned long>(frameCount, PROFILER_HISTORY - 1);
+    if (n == 0) return;
+
+    // percentiles of each channel over the history. the newest GPU timings may still be in flight, so they are skipped
+    float stats[CHANNEL_COUNT][4] = {};  // p50, p95, p99, max
+    std::vector<float> sorted;
+    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+        int first = ch >= GPU_FIRST ? PROFILER_GPU_LATENCY : 0;
+        if (first >= n) continue;
+        sorted.clear();
+        for (int i = first; i < n; ++i) sorted.push_back(get((Channel)ch, i));
+        std::sort(sorted.begin(), sorted.end());
+        int m = sorted.size();
+        stats[ch][0] = sorted[(m - 1) * 50 / 100];
+        stats[ch][1] = sorted[(m - 1) * 95 / 100];
+        stats[ch][2] = sorted[(m - 1) * 99 / 100];
+        stats[ch][3] = sorted[m - 1];
+    }
+
+    float scaleMax = std::max(budgetMs * 2, stats[FRAME][2]);
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "last %.2f ms, budget %.2f ms", get(FRAME), budgetMs);
+    ImGui::PlotHistogram("Frame Times", frameGetter, &n, n, 0, overlay, 0, scaleMax, ImVec2(0, 80));
+
+    // distribution of frame times between 0 and `scaleMax`. the last bucket also holds everything slower
+    const int buckets = 32;
+    float counts[buckets] = {};
+    for (int i = 0; i < n; ++i) counts[std::min((int)(get(FRAME, i) / scaleMax * buckets), buckets - 1)]++;
+    snprintf(overlay, sizeof(overlay), "0 - %.1f ms", scaleMax);
+    ImGui::PlotHistogram("Distribution", counts, buckets, 0, overlay, 0, FLT_MAX, ImVec2(0, 60));
+
+    if (ImGui::BeginTable("Percentiles", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+        for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(channelNames[ch]);
+            for (int s = 0; s < 4; ++s) {
+                ImGui::TableNextColumn();
+                ImVec4 col = stats[ch][s] > budgetMs ? ImVec4(1, 0.3f, 0.3f, 1) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+                ImGui::TextColored(col, "%.2f", stats[ch][s]);
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Over budget: %lu of %lu frames", overrunCount, frameCount);
+    if (overrunCount > 0) {
+        ImGui::Text("Worst: frame %lu, %.2f ms (%s %.2f ms)", worstOverrun.frame, worstOverrun.frameMs, channelNames[worstOverrun.phase], worstOverrun.phaseMs);
+        for (auto o = overruns.rbegin(); o != overruns.rend(); ++o) {
+            ImGui::BulletText("frame %lu: %.2f ms (%s %.2f ms)", o->frame, o->frameMs, channelNames[o->phase], o->phaseMs);
+        }
+    }
+}
+};  // namespace Profiler
@@ -0,0 +1,75 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+#define PROFILER_HISTORY 512    // frames of timings kept per channel
+#define PROFILER_OVERRUNS 8     // over-budget frames remembered
+#define PROFILER_GPU_LATENCY 4  // frames GPU timings may lag behind the CPU
+
+// time the enclosing scope into profiler channel `ch` (and the trace timeline)
+#define PROFILE_SCOPE(ch) Profiler::Scope TRACE_CONCAT(profileScope_, __LINE__)(ch)
+
+// Per-frame timings of the main loop's phases, with percentiles and budget alarms shown in the debug menu.
+// Recording costs a couple of clock reads per phase; statistics are only computed while the UI section is open.
+namespace Profiler {
+
+enum Channel {
+    FRAME,         // whole frame, measured between successive `beginFrame()` calls
+    POLL,          // glfwPollEvents
+    UPDATE,        // update()
+    RENDER,        // display()
+    UI,            // displayUI()
+    SWAP,          // glfwSwapBuffers
+    GPU_SOFTBODY,  // soft body draw (GPU)
+    GPU_LIGHT,     // light cube draw (GPU)
+    GPU_UI,        // ImGui draw (GPU)
+    CHANNEL_COUNT,
+    GPU_FIRST = GPU_SOFTBODY
+};
+extern const char* channelNames[CHANNEL_COUNT];
+
+// A frame that took longer than `budgetMs`
+struct Overrun {
+    unsigned long frame;  // frame number
+    float frameMs;        // whole frame time
+    Channel phase;        // slowest phase of the frame
+    float phaseMs;        // time spent in `phase`
+};
+
+extern float budgetMs;                   // frame time budget in milliseconds
+extern unsigned long frameCount;         // frames completed
+extern unsigned long overrunCount;       // frames over budget
+extern std::vector<Overrun> overruns;    // most recent over-budget frames, newest last
+extern Overrun worstOverrun;             // slowest frame so far
+
+// Close the previous frame (recording its total time and checking it against the budget) and start a new one
+extern void beginFrame();
+// Add `ms` to channel `ch` for the current frame
+extern void record(Channel ch, float ms);
+// Set channel `ch` of an earlier frame, `frame`, to `ms`. Used for results that arrive late, such as GPU timings
+extern void record(Channel ch, float ms, unsigned long frame);
+// Get the time of channel `ch` `age` frames ago (0 = last completed frame)
+extern float get(Channel ch, int age = 0);
+// Draw the "Frame Timings" section. Call inside an ImGui window
+extern void drawUI();
+
+// Records the time between its construction and destruction into a channel
+struct Scope {
+    Channel channel;
+    Trace::Scope trace;
+    std::chrono::steady_clock::time_point start;
+    Scope(Channel ch) : channel(ch), trace(channelNames[ch], "frame"), start(std::chrono::steady_clock::now()) {}
+    ~Scope() {
+        record(channel, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+};  // namespace Profiler
+
+#endif /* PROFILER_H */
@@ -0,0 +1,258 @@
+#include "sdf.h"
+
+#include <map>
+#include <unordered_map>
+
+// FNV-1a over the mesh data and bake settings, so a stale cache is rebaked when the model or settings change
+static unsigned long long cacheKey(StaticMesh* mesh, float cellSize, int band) {
+    unsigned long long h = 14695981039346656037ULL;
+    auto add = [&](const void* data, size_t bytes) {
+        const unsigned char* b = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) h = (h ^ b[i]) * 1099511628211ULL;
+    };
+    int version = SDF_VERSION;
+    add(&version, sizeof(version));
+    add(&cellSize, sizeof(cellSize));
+    add(&band, sizeof(band));
+    add(mesh->vertices.data(), mesh->vertices.size() * sizeof(vec3));
+    add(mesh->indices.data(), mesh->indices.size() * sizeof(unsigned int));
+    for (const auto& m : mesh->meshes) add(&m.baseVertex, sizeof(m.baseVertex));
+    return h;
+}
+
+SDFCollider::SDFCollider(StaticMesh* mesh, float cellSize, int band, mat4 transform) {
+    TRACE_SCOPE_CAT("SDFCollider::SDFCollider", "load");
+    this->cellSize = cellSize;
+    this->band = band;
+    setTransform(transform);
+    // meshes not loaded from a file (e.g. procedural ones) are baked every time
+    if (!mesh->mesh_path.empty()) path = SDFPATH(mesh->mesh_path);
+    unsigned long long key = cacheKey(mesh, cellSize, band);
+    if (loadCache(key)) return;
+    if (bake(mesh) && !path.empty()) saveCache(key);
+}
+
+void SDFCollider::setTransform(mat4 m) {
+    transform = m;
+    invTransform = inverse(m);
+}
+
+// compute the field from the mesh's triangles. exact distances are found for samples in the band with a BVH over the triangles,
+// and the sign comes from a flood fill of the outside, so the mesh should be closed
+bool SDFCollider::bake(StaticMesh* mesh) {
+    TRACE_SCOPE_CAT("SDFCollider::bake", "load");
+    std::vector<ivec3> triangles;
+    for (const auto& m : mesh->meshes) {
+        for (unsigned int i = m.baseIndex; i + 2 < m.baseIndex + m.n_Indices; i += 3) {
+            triangles.push_back(ivec3(mesh->indices[i], mesh->indices[i + 1], mesh->indices[i + 2]) + (int)m.baseVertex);
+        }
+    }
+    if (triangles.empty()) {
+        std::cout << "Failed to bake SDF for " << mesh->name << ": mesh has no triangles" << std::endl;
+        return false;
+    }
+    const std::vector<vec3>& vs = mesh->vertices;
+
+    // grid over the mesh bounds, padded so the band never touches the grid's edge
+    BVH::AABB bounds;
+    std::vector<BVH::AABB> boxes(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        for (int k = 0; k < 3; ++k) boxes[i].grow(vs[triangles[i][k]]);
+        bounds.grow(boxes[i]);
+    }
+    float pad = (band + 1) * cellSize;
+    origin = bounds.low - vec3(pad);
+    dims = ivec3((bounds.high - bounds.low + vec3(2 * pad)) / cellSize) + ivec3(2);
+    int count = dims.x * dims.y * dims.z;
+    float farDist = band * cellSize;
+    distances.assign(count, farDist);
+
+    // mark the samples within `band` cells of each triangle
+    std::vector<char> inBand(count, 0);
+    for (const auto& b : boxes) {
+        ivec3 lo = max(ivec3(floor((b.low - origin) / cellSize)) - ivec3(band), ivec3(0));
+        ivec3 hi = min(ivec3(floor((b.high - origin) / cellSize)) + ivec3(band + 1), dims - ivec3(1));
+        for (int z = lo.z; z <= hi.z; ++z) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                for (int x = lo.x; x <= hi.x; ++x) inBand[index(x, y, z)] = 1;
+            }
+        }
+    }
+    std::vector<int> bandSamples;
+    for (int i = 0; i < count; ++i) {
+        if (inBand[i]) bandSamples.push_back(i);
+    }
+
+    // angle-weighted pseudonormals (Baerentzen and Aanaes): each face's normal, each edge's the sum of its faces' normals, and each vertex's
+    // the sum of its faces' normals weighted by their angle at it. unlike the normal of any one face, these give the right sign for a point
+    // closest to an edge or a vertex, even at a concave crease. vertices at the same position are welded, as meshes split them along seams
+    std::vector<int> welded(vs.size());
+    std::map<std::tuple<float, float, float>, int> firstAt;
+    for (size_t i = 0; i < vs.size(); ++i) welded[i] = firstAt.try_emplace({vs[i].x, vs[i].y, vs[i].z}, i).first->second;
+    auto edgeKey = [&](int a, int b) {
+        a = welded[a], b = welded[b];
+        if (a > b) std::swap(a, b);
+        return (unsigned long long)a << 32 | (unsigned int)b;
+    };
+    std::vector<vec3> faceNormals(triangles.size()), vertexNormals(vs.size(), vec3(0));
+    std::unordered_map<unsigned long long, vec3> edgeNormals;
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        const ivec3& tri = triangles[t];
+        vec3 n = cross(vs[tri.y] - vs[tri.x], vs[tri.z] - vs[tri.x]);
+        faceNormals[t] = length(n) > 0 ? normalize(n) : vec3(0);
+        for (int k = 0; k < 3; ++k) {
+            int a = tri[k], b = tri[(k + 1) % 3], c = tri[(k + 2) % 3];
+            vec3 e1 = vs[b] - vs[a], e2 = vs[c] - vs[a];
+            if (length(e1) > 0 && length(e2) > 0) vertexNormals[welded[a]] += acos(clamp(dot(normalize(e1), normalize(e2)), -1.f, 1.f)) * faceNormals[t];
+            edgeNormals[edgeKey(a, b)] += faceNormals[t];
+        }
+    }
+    // the pseudonormal of the feature of triangle `t` that its point `q` lies on, found from `q`'s barycentric coordinates
+    auto pseudonormal = [&](int t, vec3 q) {
+        const ivec3& tri = triangles[t];
+        vec3 ab = vs[tri.y] - vs[tri.x], ac = vs[tri.z] - vs[tri.x], aq = q - vs[tri.x];
+        float d00 = dot(ab, ab), d01 = dot(ab, ac), d11 = dot(ac, ac), d20 = dot(aq, ab), d21 = dot(aq, ac);
+        float denom = d00 * d11 - d01 * d01;
+        if (denom <= 0) return faceNormals[t];
+        float v = (d11 * d20 - d01 * d21) / denom, w = (d00 * d21 - d01 * d20) / denom;
+        vec3 bary(1 - v - w, v, w);
+        const float eps = 1e-4f;
+        int zeros = 0, zero = 0, nonZero = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (bary[k] <= eps) zeros++, zero = k;
+            else nonZero = k;
+        }
+        if (zeros == 0) return faceNormals[t];
+        if (zeros == 1) return edgeNormals.at(edgeKey(tri[(zero + 1) % 3], tri[(zero + 2) % 3]));
+        return vertexNormals[welded[tri[nonZero]]];
+    };
+
+    // exact distance to the closest triangle. samples within half a cell of the surface take their sign from the pseudonormal at the
+    // closest point, as a surface can pass between them and their neighbours
+    BVH bvh;
+    bvh.build(boxes);
+    std::vector<char> nearSurface(count, 0);
+    std::for_each(std::execution::par, bandSamples.begin(), bandSamples.end(), [&](int i) {
+        vec3 p = origin + vec3(i % dims.x, (i / dims.x) % dims.y, i / (dims.x * dims.y)) * cellSize;
+        float sqDist;
+        int t = bvh.nearest(p, [&](int t, vec3 q) {
+            return Util::sqDist(q, Util::closestPointOnTriangle(q, vs[triangles[t].x], vs[triangles[t].y], vs[triangles[t].z]));
+        }, &sqDist);
+        float d = std::min(sqrt(sqDist), farDist);
+        if (d <= cellSize * 0.5f) {
+            const ivec3& tri = triangles[t];
+            vec3 closest = Util::closestPointOnTriangle(p, vs[tri.x], vs[tri.y], vs[tri.z]);
+            if (dot(p - closest, pseudonormal(t, closest)) < 0) d = -d;
+            nearSurface[i] = 1;
+        }
+        distances[i] = d;
+    });
+
+    // flood the outside from the grid's edge. a path between neighbouring samples further than half a cell from the surface cannot cross it,
+    // so everything else that is not near the surface is inside
+    std::vector<char> outside(count, 0);
+    std::vector<int> queue;
+    for (int z = 0; z < dims.z; ++z) {
+        for (int y = 0; y < dims.y; ++y) {
+            for (int x = 0; x < dims.x; ++x) {
+                if (x > 0 && y > 0 && z > 0 && x < dims.x - 1 && y < dims.y - 1 && z < dims.z - 1) continue;
+                outside[index(x, y, z)] = 1;
+                queue.push_back(index(x, y, z));
+            }
+        }
+    }
+    int steps[6] = {1, -1, dims.x, -dims.x, dims.x * dims.y, -dims.x * dims.y};
+    for (size_t q = 0; q < queue.size(); ++q) {
+        int i = queue[q];
+        ivec3 c(i % dims.x, (i / dims.x) % dims.y, i / (dims.x * dims.y));
+        for (int s = 0; s < 6; ++s) {
+            // stay inside the grid
+            int axis = s / 2;
+            int next = c[axis] + (s % 2 == 0 ? 1 : -1);
+            if (next < 0 || next >= dims[axis]) continue;
+            int n = i + steps[s];
+            if (outside[n] || nearSurface[n]) continue;
+            outside[n] = 1;
+            queue.push_back(n);
+        }
+    }
+    std::for_each(std::execution::par, bandSamples.begin(), bandSamples.end(), [&](int i) {
+        if (!nearSurface[i] && !outside[i]) distances[i] = -distances[i];
+    });
+    for (int i = 0; i < count; ++i) {
+        if (!inBand[i] && !outside[i]) distances[i] = -farDist;
+    }
+    printf("Baked SDF for %s (%d x %d x %d samples, %zu in band)\n", mesh->name.c_str(), dims.x, dims.y, dims.z, bandSamples.size());
+    return true;
+}
+
+// read the field back from `path` if it was baked with the same mesh and settings
+bool SDFCollider::loadCache(unsigned long long key) {
+    if (path.empty()) return false;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    unsigned long long fileKey = 0;
+    file.read((char*)&fileKey, sizeof(fileKey));
+    if (!file || fileKey != key) return false;
+    file.read((char*)&origin, sizeof(origin));
+    file.read((char*)&dims, sizeof(dims));
+    distances.resize((size_t)dims.x * dims.y * dims.z);
+    file.read((char*)distances.data(), distances.size() * sizeof(float));
+    if (!file) {
+        std::cout << "Failed to read SDF cache " << path << std::endl;
+        distances.clear();
+        return false;
+    }
+    return true;
+}
+
+void SDFCollider::saveCache(unsigned long long key) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to write SDF cache " << path << std::endl;
+        return;
+    }
+    file.write((const char*)&key, sizeof(key));
+    file.write((const char*)&origin, sizeof(origin));
+    file.write((const char*)&dims, sizeof(dims));
+    file.write((const char*)distances.data(), distances.size() * sizeof(float));
+}
+
+float SDFCollider::sample(vec3 p, vec3* grad) const {
+    vec3 g = (p - origin) / cellSize;
+    ivec3 c = ivec3(floor(g));
+    if (c.x < 0 || c.y < 0 || c.z < 0 || c.x >= dims.x - 1 || c.y >= dims.y - 1 || c.z >= dims.z - 1) {
+        if (grad) *grad = vec3(0);
+        return band * cellSize;
+    }
+    vec3 f = g - vec3(c);
+    int i = index(c.x, c.y, c.z);
+    int dy = dims.x, dz = dims.x * dims.y;
+    float d000 = distances[i], d100 = distances[i + 1];
+    float d010 = distances[i + dy], d110 = distances[i + dy + 1];
+    float d001 = distances[i + dz], d101 = distances[i + dz + 1];
+    float d011 = distances[i + dy + dz], d111 = distances[i + dy + dz + 1];
+    // interpolate along x, then y, then z
+    float d00 = d000 + (d100 - d000) * f.x, d10 = d010 + (d110 - d010) * f.x;
+    float d01 = d001 + (d101 - d001) * f.x, d11 = d011 + (d111 - d011) * f.x;
+    float d0 = d00 + (d10 - d00) * f.y, d1 = d01 + (d11 - d01) * f.y;
+    if (grad) {
+        // derivatives of the trilinear interpolant, per cell
+        float gx0 = (d100 - d000) + ((d110 - d010) - (d100 - d000)) * f.y;
+        float gx1 = (d101 - d001) + ((d111 - d011) - (d101 - d001)) * f.y;
+        *grad = vec3(gx0 + (gx1 - gx0) * f.z, (d10 - d00) + ((d11 - d01) - (d10 - d00)) * f.z, d1 - d0) / cellSize;
+    }
+    return d0 + (d1 - d0) * f.z;
+}
+
+bool SDFCollider::project(vec3& p, float margin) const {
+    vec3 grad;
+    float d = sample(p, &grad);
+    if (d >= margin) return false;
+    float len = length(grad);
+    if (len < 1e-6f) return false;  // deep inside, beyond the band
+    p += grad * ((margin - d) / len);
+    return true;
+}
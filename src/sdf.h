@@ -0,0 +1,48 @@
+#ifndef SDF_H
+#define SDF_H
+
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "bvh.h"
+#include "staticmesh.h"
+#include "util.h"
+
+#define SDFPATH(m) MODELPATH(m) + "SDF/" + MODEL_NO_DIR(m) + ".sdf"
+#define SDF_VERSION 2  // bump when the cache layout or baking changes
+
+// Collider for static scenery, represented by a signed distance field sampled on a grid around a `StaticMesh` (negative inside).
+// Distances are only computed exactly within `band` cells of the surface; further cells are clamped to +/- `band` cells, which is all collision needs.
+// The field is baked once when the collider is made and cached on disk next to the model, so later runs only read it back.
+// Lookups are a trilinear interpolation of 8 samples, so each query costs the same however many triangles the mesh has.
+class SDFCollider {
+   public:
+    // Bake (or load from the cache) the field of `mesh` with grid spacing `cellSize`, placed in the world by `transform` (rigid only)
+    SDFCollider(StaticMesh* mesh, float cellSize, int band = 4, mat4 transform = mat4(1));
+
+    // Place the collider in the world. Scaling is not supported, as distances would no longer be in world units
+    void setTransform(mat4 m);
+    // Signed distance at `p` (in the collider's space), and its gradient in `grad` if given. Points outside the grid are treated as far away
+    float sample(vec3 p, vec3* grad = nullptr) const;
+    // Push `p` (in the collider's space) out to at least `margin` from the surface. Returns false if it was already clear
+    bool project(vec3& p, float margin = 0) const;
+
+    bool bake(StaticMesh* mesh);
+    bool loadCache(unsigned long long key);
+    void saveCache(unsigned long long key);
+
+    int index(int x, int y, int z) const { return (z * dims.y + y) * dims.x + x; }
+
+    std::string path;              // cache file. empty if the mesh has no file to cache next to
+    mat4 transform = mat4(1);      // collider space to world space
+    mat4 invTransform = mat4(1);   // world space to collider space
+    vec3 origin = vec3(0);         // position of sample (0, 0, 0)
+    ivec3 dims = ivec3(0);         // samples along each axis
+    float cellSize = 0.1f;         // spacing between samples
+    int band = 4;                  // exact distances are kept within this many cells of the surface
+    std::vector<float> distances;  // signed distance at each sample, x fastest
+};
+
+#endif /* SDF_H */
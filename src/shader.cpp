@@ -29,6 +29,7 @@ void Shader::AddShader(GLuint ShaderProgram, const char* pShaderText,
 }
 
 GLuint Shader::CompileShaders(const char* pVS, const char* pFS) {
+    TRACE_SCOPE_CAT("Shader::CompileShaders", "load");
     // Start the process of setting up our shaders by creating a program ID
     // Note: we will link all the shaders together into this ID
     GLuint shaderProgramID = glCreateProgram();
@@ -79,6 +80,7 @@ GLuint Shader::CompileShaders(const char* pVS, const char* pFS) {
 }
 
 GLuint Shader::CompileComputeShader(const char* pCS) {
+    TRACE_SCOPE_CAT("Shader::CompileComputeShader", "load");
     // Start the process of setting up our shaders by creating a program ID
     // Note: we will link all the shaders together into this ID
     GLuint shaderProgramID = glCreateProgram();
@@ -127,6 +129,7 @@ GLuint Shader::CompileComputeShader(const char* pCS) {
 }
 
 GLuint Shader::CompileComputeShaderGroup(std::vector<std::string> pCSs) {
+    TRACE_SCOPE_CAT("Shader::CompileComputeShaderGroup", "load");
     // Start the process of setting up our shaders by creating a program ID
     // Note: we will link all the shaders together into this ID
     GLuint shaderProgramID = glCreateProgram();
@@ -1,7 +1,16 @@
 #include "softbody.h"
 
+#include <bit>
+
+// load the tetrahedral mesh stored alongside the visual mesh
 void SoftBody::loadTetraFile() {
-    tetraPath = TETRAPATH(mesh->mesh_path);
+    loadTetraFile(TETRAPATH(mesh->mesh_path));
+}
+
+// load the tetrahedral mesh at `path`
+void SoftBody::loadTetraFile(std::string path) {
+    TRACE_SCOPE_CAT("SoftBody::loadTetraFile", "load");
+    tetraPath = path;
     std::ifstream file(tetraPath);
     if (!file.is_open()) {
         std::cout << "Failed to open file " << tetraPath << std::endl;
@@ -78,11 +87,40 @@ void SoftBody::loadTetraFile() {
     assert(tetraNeighbours.size() == tns && "mismatched tetra neighbour count");
 
     file.close();
-    printf("Successfully loaded tetrahedral mesh \"%s.tetra\"\n", MODEL_NO_DIR(mesh->mesh_path).c_str());
+    printf("Successfully loaded tetrahedral mesh \"%s\"\n", tetraPath.c_str());
     printf("%d vs, %d es, %d ts\n", vs, es, ts);
     return;
 }
 
+// copy the topology of a procedurally generated shape
+void SoftBody::loadTetMesh(const ProcMesh::TetMesh& tm) {
+    tetraPath = "";
+    vertices.reserve(tm.vertices.size());
+    edges.reserve(tm.edges.size());
+    tetras.reserve(tm.tetras.size());
+    tetraNeighbours.reserve(tm.neighbours.size());
+    for (const auto& v : tm.vertices) vertices.emplace_back(vertices.size(), v);
+    for (const auto& e : tm.edges) edges.emplace_back(edges.size(), e.x, e.y);
+    for (const auto& t : tm.tetras) tetras.emplace_back(tetras.size(), t.x, t.y, t.z, t.w);
+    for (const auto& n : tm.neighbours) tetraNeighbours.emplace_back(n.x, n.y, n.z, n.w);
+}
+
+// set up the simulation once the tetrahedral and visual meshes are loaded
+void SoftBody::initBody() {
+    TRACE_SCOPE_CAT("SoftBody::initBody", "load");
+    tetraCount = tetras.size();
+    tVertexCount = vertices.size();
+    mVertexCount = mesh->vertices.size();
+    tvIndices.resize(tVertexCount);
+    mvIndices.resize(mVertexCount);
+    tetraMap.resize(mVertexCount);
+    std::iota(tvIndices.begin(), tvIndices.end(), 0);  // set to 0, 1, 2, ..., tVertexCount
+    std::iota(mvIndices.begin(), mvIndices.end(), 0);  // set to 0, 1, 2, ..., mVertexCount
+    initPhysics();
+    computeSkinningInfo();
+    bounds = {50, 50, 50};
+}
+
 long long SoftBody::getHashKey(ivec3 cell) {
     long long s = (cell.x * 6096427489LL) + (cell.y * 4039848257LL) + (cell.z * 5993801789LL);
     return s;
@@ -92,9 +130,10 @@ ivec3 SoftBody::getCellCoord(vec3 p) {
     return ivec3(floor(p.x / cellSize), floor(p.y / cellSize), floor(p.z / cellSize));
 }
 
-// populate the cell to mesh map
+// populate the cell to mesh map. runs sequentially, since every insertion may modify the map
 void SoftBody::initHash() {
-    std::for_each(std::execution::par, mvIndices.begin(), mvIndices.end(), [&](auto&& i) {
+    TRACE_SCOPE_CAT("SoftBody::initHash", "load");
+    std::for_each(mvIndices.begin(), mvIndices.end(), [&](auto&& i) {
         vec3 mv = mesh->vertices[i];
         ivec3 cell = getCellCoord(mv);
         long long key = getHashKey(cell);
@@ -135,6 +174,14 @@ void SoftBody::initPhysics() {
     for (auto& e : edges) {
         e.restLength = distance(vertices[e.x1].position, vertices[e.x2].position);
     }
+    restPositions.resize(vertices.size());
+    for (const auto& v : vertices) restPositions[v.vID] = v.position;
+    restShapes.resize(tetras.size());
+    for (const auto& tet : tetras) {
+        vec3 p1 = vertices[tet.x1].position;
+        mat3 Dm = mat3(vertices[tet.x2].position - p1, vertices[tet.x3].position - p1, vertices[tet.x4].position - p1);
+        restShapes[tet.tID] = tet.restVolume != 0 ? inverse(Dm) : mat3(0);
+    }
 }
 
 // calculate the volume of the tetrahedra `i`
@@ -158,159 +205,1370 @@ float SoftBody::computeTetraVolume(vec3 p1, vec3 p2, vec3 p3, vec3 p4) {
     return f * dot(c_21_31, x41);
 }
 
-// create a hashed position for each mesh vertex
-void SoftBody::computeSkinningInfo() {
-    // for (const auto& [key, value] : cellToVis)
-    //     std::cout << '[' << key << "] = " << value.size() << "; " << std::endl;
-    const std::vector<vec3>& mvs = mesh->vertices;
-    std::vector<float> minDist(mVertexCount, std::numeric_limits<float>::max());
-    vec3 tCentre = vec3(0);
-    mat3 P = mat3(0);
-    vec4 bary = vec4(0);
-    int cnt = 0;
+// bound the tetrahedra at their current positions
+static void computeTetBoxes(const std::vector<SoftBody::Tetra>& tetras, const std::vector<SoftBody::Vertex>& vertices, std::vector<BVH::AABB>& boxes) {
+    boxes.resize(tetras.size());
     std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](auto&& tet) {
-        vec3 p1 = vertices[tet.x1].position;
-        vec3 p2 = vertices[tet.x2].position;
-        vec3 p3 = vertices[tet.x3].position;
-        vec3 p4 = vertices[tet.x4].position;
-        tCentre = vec3(0);
-        // tCentre is avg of coords
-        tCentre += (p1 + p2 + p3 + p4) * 0.25f;
-
-        // find the largest radius that encompasses all tetrahedron points
-        float maxRadius = 0;
-        maxRadius = max(maxRadius, distance(p1, tCentre));
-        maxRadius = max(maxRadius, distance(p2, tCentre));
-        maxRadius = max(maxRadius, distance(p3, tCentre));
-        maxRadius = max(maxRadius, distance(p4, tCentre));
-        maxRadius += cellSize;
-
-        queryNearbyMV(tCentre, maxRadius);
-        if (queryIDs.empty()) return;
-
-        // create matrix from vertices, subtracting the contrained point `p4`
-        vec3 x14 = p1 - p4;
-        vec3 x24 = p2 - p4;
-        vec3 x34 = p3 - p4;
-        P = mat3(x14, x24, x34);
-        P = inverse(P); // v - p4 = Pb ==> b = inv(P)(v - p4)
-
-        std::for_each(queryIDs.begin(), queryIDs.end(), [&](auto&& id) {
-            int mID = id; // visual mesh vertex ID
-            vec3 v = mesh->vertices[mID];
-
-            if (minDist[mID] <= 0) return; // already have skinning info (dist is negative or 0)
-            if (distance(v, tCentre) > maxRadius) return; // outside search radius
-            cnt++;
-            // compute barycentric coordinates
-            vec3 vp_4 = v - p4;
-            vec3 b = P * vp_4;
-            bary = vec4(b, 1 - b.x - b.y - b.z);
-            
-            // compute max min dists and update the closest tetrahedron for visual mesh vertex `i`
-            float dst = 0;
-            dst = max(dst, -bary.x);
-            dst = max(dst, -bary.y);
-            dst = max(dst, -bary.z);
-            dst = max(dst, -bary.w);
-            if (dst < minDist[mID]) {
-                minDist[mID] = dst;
-                tetraMap[mID] = {tet.tID, b};
+        BVH::AABB& b = boxes[tet.tID];
+        b = BVH::AABB();
+        b.grow(vertices[tet.x1].position);
+        b.grow(vertices[tet.x2].position);
+        b.grow(vertices[tet.x3].position);
+        b.grow(vertices[tet.x4].position);
+    });
+}
+
+// build the hierarchy over the tetrahedra at their current positions
+void SoftBody::buildTetBVH() {
+    computeTetBoxes(tetras, vertices, tetBoxes);
+    tetBVH.build(tetBoxes);
+}
+
+// refit the tetrahedra hierarchy to the current positions, building it first if needed
+void SoftBody::refitTetBVH() {
+    if (tetBVH.empty()) return buildTetBVH();
+    computeTetBoxes(tetras, vertices, tetBoxes);
+    tetBVH.refit(tetBoxes);
+}
+
+// collect the boundary faces of the tetrahedral mesh (faces without a neighbouring tetrahedron) and build a hierarchy over them
+void SoftBody::initSurface() {
+    TRACE_SCOPE_CAT("SoftBody::initSurface", "load");
+    surfaceFaces.clear();
+    auto addFace = [&](const Tetra& tet, int k) {
+        ivec3 v;
+        for (int j = 0, n = 0; j < 4; ++j) {
+            if (j != k) v[n++] = tet.corner(j);
+        }
+        surfaceFaces.push_back({tet.tID, k, v});
+    };
+    if ((int)tetraNeighbours.size() == tetraCount) {
+        // neighbour k is opposite corner k
+        for (const auto& tet : tetras) {
+            auto [n1, n2, n3, n4] = tetraNeighbours[tet.tID];
+            int ns[4] = {n1, n2, n3, n4};
+            for (int k = 0; k < 4; ++k) {
+                if (ns[k] < 0) addFace(tet, k);
             }
+        }
+    } else {
+        // no adjacency, so find the faces used by only one tetrahedron
+        std::map<std::tuple<int, int, int>, std::pair<int, int>> faces;  // sorted face vertices -> (uses, tetrahedron * 4 + corner)
+        for (const auto& tet : tetras) {
+            for (int k = 0; k < 4; ++k) {
+                int v[3];
+                for (int j = 0, n = 0; j < 4; ++j) {
+                    if (j != k) v[n++] = tet.corner(j);
+                }
+                std::sort(v, v + 3);
+                auto& f = faces[{v[0], v[1], v[2]}];
+                f.first++;
+                f.second = tet.tID * 4 + k;
+            }
+        }
+        for (const auto& [key, f] : faces) {
+            if (f.first == 1) addFace(tetras[f.second / 4], f.second % 4);
+        }
+    }
+    sfIndices.resize(surfaceFaces.size());
+    std::iota(sfIndices.begin(), sfIndices.end(), 0);
+    std::vector<BVH::AABB> boxes(surfaceFaces.size());
+    for (size_t i = 0; i < surfaceFaces.size(); ++i) {
+        for (int k = 0; k < 3; ++k) boxes[i].grow(vertices[surfaceFaces[i].v[k]].position);
+    }
+    surfaceBVH.build(boxes);
+    surfaceDirty = false;
+}
+
+// refit the surface hierarchy to the current vertex positions
+void SoftBody::refitSurface() {
+    if (surfaceFaces.empty()) return initSurface();
+    surfaceBoxes.resize(surfaceFaces.size());
+    std::for_each(std::execution::par, sfIndices.begin(), sfIndices.end(), [&](int i) {
+        BVH::AABB& b = surfaceBoxes[i];
+        b = BVH::AABB();
+        for (int k = 0; k < 3; ++k) b.grow(vertices[surfaceFaces[i].v[k]].position);
+    });
+    surfaceBVH.refit(surfaceBoxes);
+    surfaceDirty = false;
+}
+
+// find the first point where the ray `origin + t * dir` (in the body's space) hits the tetrahedral mesh's surface, with t <= `tMax`
+bool SoftBody::raycast(vec3 origin, vec3 dir, RayHit& hit, float tMax) {
+    TRACE_SCOPE_CAT("SoftBody::raycast", "sim");
+    if (surfaceDirty) refitSurface();
+    vec2 uv, bestUV;
+    int f = surfaceBVH.raycast(origin, dir, tMax, [&](int i, float& tBest) {
+        const ivec3& v = surfaceFaces[i].v;
+        float t;
+        if (!Util::rayTriangle(origin, dir, vertices[v.x].position, vertices[v.y].position, vertices[v.z].position, t, uv) || t > tBest) return false;
+        tBest = t;
+        bestUV = uv;
+        return true;
+    });
+    if (f < 0) return false;
+
+    // spread the face's barycentric coords over the tetrahedron's corners. the opposite corner has weight 0
+    const SurfaceFace& face = surfaceFaces[f];
+    float w[3] = {1 - bestUV.x - bestUV.y, bestUV.x, bestUV.y};
+    hit.tID = face.tID;
+    hit.bary = vec4(0);
+    for (int j = 0, n = 0; j < 4; ++j) {
+        if (j != face.corner) hit.bary[j] = w[n++];
+    }
+    hit.t = tMax;
+    hit.point = origin + dir * tMax;
+    return true;
+}
+
+// grab the surface vertex under the world-space ray `origin + t * dir`, pinning it to the ray until `releaseGrab()`. Returns false if the ray misses
+bool SoftBody::grab(vec3 origin, vec3 dir) {
+    releaseGrab();
+    // keep `dir` unnormalised in the body's space, so hit distances are the same in both spaces
+    mat4 inv = inverse(transform);
+    vec3 o = vec3(inv * vec4(origin, 1));
+    vec3 d = mat3(inv) * dir;
+    RayHit hit;
+    if (!raycast(o, d, hit)) return false;
+
+    // hold the corner closest to the hit point
+    int k = 0;
+    for (int j = 1; j < 4; ++j) {
+        if (hit.bary[j] > hit.bary[k]) k = j;
+    }
+    grabbed = tetras[hit.tID].corner(k);
+    grabInvMass = vertices[grabbed].invMass;
+    vertices[grabbed].invMass = 0;
+    vertices[grabbed].velocity = vec3(0);
+    grabDepth = hit.t;
+    grabOffset = vertices[grabbed].position - hit.point;
+    grabStart = grabTarget = vertices[grabbed].position;
+    collectGrabRegion(hit.tID);
+    return true;
+}
+
+// move the grabbed vertex to the new world-space cursor ray, at the depth it was grabbed at
+void SoftBody::moveGrab(vec3 origin, vec3 dir) {
+    if (grabbed < 0) return;
+    mat4 inv = inverse(transform);
+    grabTarget = vec3(inv * vec4(origin, 1)) + (mat3(inv) * dir) * grabDepth + grabOffset;
+}
+
+// let go of the grabbed vertex. it keeps the velocity it was last dragged with
+void SoftBody::releaseGrab() {
+    if (grabbed < 0) return;
+    vertices[grabbed].invMass = grabInvMass;
+    grabbed = -1;
+    grabTetras.clear();
+    grabEdges.clear();
+}
+
+// gather the tetrahedra within `grabRings` face-neighbours of tetrahedron `tID`, and the edges between their vertices
+void SoftBody::collectGrabRegion(int tID) {
+    grabTetras.clear();
+    grabEdges.clear();
+    if ((int)tetraNeighbours.size() != tetraCount) return;  // needs adjacency
+    std::vector<char> seen(tetraCount, 0);
+    std::vector<char> inRegion(tVertexCount, 0);
+    grabTetras.push_back(tID);
+    seen[tID] = 1;
+    // breadth-first, one ring at a time
+    size_t ringStart = 0;
+    for (int ring = 0; ring < grabRings; ++ring) {
+        size_t ringEnd = grabTetras.size();
+        for (size_t i = ringStart; i < ringEnd; ++i) {
+            auto [n1, n2, n3, n4] = tetraNeighbours[grabTetras[i]];
+            for (int n : {n1, n2, n3, n4}) {
+                if (n < 0 || seen[n]) continue;
+                seen[n] = 1;
+                grabTetras.push_back(n);
+            }
+        }
+        ringStart = ringEnd;
+    }
+    for (int t : grabTetras) {
+        for (int k = 0; k < 4; ++k) inRegion[tetras[t].corner(k)] = 1;
+    }
+    for (const auto& e : edges) {
+        if (inRegion[e.x1] && inRegion[e.x2]) grabEdges.push_back(e.eID);
+    }
+}
+
+// embed each of `points` in the tetrahedron containing it, or the closest tetrahedron if it is outside the mesh. `bvh` is built over `tetras`
+static void embed(const std::vector<vec3>& points, const std::vector<SoftBody::Vertex>& vertices, const std::vector<SoftBody::Tetra>& tetras,
+                  const BVH& bvh, std::vector<std::pair<int, vec4>>& out) {
+    auto bary = [&](int t, vec3 p) {
+        const SoftBody::Tetra& tet = tetras[t];
+        return Util::tetraBarycentric(p, vertices[tet.x1].position, vertices[tet.x2].position, vertices[tet.x3].position, vertices[tet.x4].position);
+    };
+    auto sqDist = [&](int t, vec3 p) {
+        const SoftBody::Tetra& tet = tetras[t];
+        return Util::sqDistToTetra(p, vertices[tet.x1].position, vertices[tet.x2].position, vertices[tet.x3].position, vertices[tet.x4].position);
+    };
+    out.resize(points.size());
+    std::vector<int> indices(points.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    // every point is independent
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](auto&& i) {
+        vec3 v = points[i];
+        int tID = -1;
+        bvh.queryPoint(v, [&](int t) {
+            vec4 b = bary(t, v);
+            if (min(min(b.x, b.y), min(b.z, b.w)) >= -1e-6f) tID = t;
+            return tID >= 0;
         });
+        if (tID < 0) tID = bvh.nearest(v, sqDist);
+        out[i] = {tID, bary(tID, v)};
     });
 }
 
-void SoftBody::solveEdgeConstraint() {
-    std::for_each(std::execution::par, edges.begin(), edges.end(), [&](auto&& e) {
-        if (vertices[e.x1].invMass + vertices[e.x2].invMass == 0) return;
-        vec3 offset_i = vertices[e.x1].position - vertices[e.x2].position;
-        vec3 offset_j = -offset_i;
-        float l = length(offset_i);
-        float C = l - e.restLength;
-        vec3 dxi = normalize(offset_i);  // constraint gradient for i
-        vec3 dxj = normalize(offset_j);  // constraint gradient for j
-        float denom = (vertices[e.x1].invMass) +
-                      (vertices[e.x2].invMass) +
-                      (edgeCompliance / (sdt * sdt));
-        // denom += 1e-3f;  // to avoid division by 0. also needs the timestep needs to be low enough to avoid NaN values
-        float lambda = -C / denom;
-        vertices[e.x1].position += lambda * vertices[e.x1].invMass * dxi;
-        vertices[e.x2].position += lambda * vertices[e.x2].invMass * dxj;
+// embed each visual mesh vertex in the tetrahedron containing it, or the closest tetrahedron if it is outside the tetrahedral mesh
+void SoftBody::computeSkinningInfo() {
+    TRACE_SCOPE_CAT("SoftBody::computeSkinningInfo", "load");
+    buildTetBVH();
+    std::vector<std::pair<int, vec4>> embedding;
+    embed(mesh->vertices, vertices, tetras, tetBVH, embedding);
+    tetraMap.resize(mVertexCount);
+    std::for_each(std::execution::par, mvIndices.begin(), mvIndices.end(), [&](auto&& i) {
+        tetraMap[i] = {embedding[i].first, vec3(embedding[i].second)};
+    });
+}
+
+// set each vertex of a coarse level so that interpolating level 0 back out of it matches level 0 as closely as possible.
+// the velocities are fitted the same way unless `withVelocity` is false, which halves the solves when only positions are read
+static void interpolate(const SoftBody::Level& level, const std::vector<SoftBody::Vertex>& from, std::vector<SoftBody::Vertex>& to, bool withVelocity = true) {
+    int n = to.size();
+    int count = withVelocity ? 6 : 3;  // right-hand sides: x, y, z of the positions, then of the velocities
+    std::vector<double> rhs(count * n);
+    std::for_each(std::execution::par, to.begin(), to.end(), [&](auto&& v) {
+        dvec3 p = dvec3(0), u = dvec3(0);
+        for (int k = level.inFullOffsets[v.vID]; k < level.inFullOffsets[v.vID + 1]; ++k) {
+            auto [j, w] = level.inFull[k];
+            p += dvec3(from[j].position) * (double)w;
+            if (withVelocity) u += dvec3(from[j].velocity) * (double)w;
+        }
+        for (int a = 0; a < 3; ++a) {
+            rhs[a * n + v.vID] = p[a];
+            if (withVelocity) rhs[(a + 3) * n + v.vID] = u[a];
+        }
+    });
+    int axes[6] = {0, 1, 2, 3, 4, 5};
+    std::for_each(std::execution::par, axes, axes + count, [&](int a) { level.restriction.solve(&rhs[a * n]); });
+    std::for_each(std::execution::par, to.begin(), to.end(), [&](auto&& v) {
+        v.position = vec3(rhs[v.vID], rhs[n + v.vID], rhs[2 * n + v.vID]);
+        if (withVelocity) v.velocity = vec3(rhs[3 * n + v.vID], rhs[4 * n + v.vID], rhs[5 * n + v.vID]);
     });
 }
 
+// generate `count - 1` coarser levels, each a cage of cells `coarsening` times the size of the previous level's, starting from the mean rest edge length.
+// every level is set up from the level 0 rest pose, so this should be called before simulating
+void SoftBody::buildLODs(int count, float coarsening) {
+    TRACE_SCOPE_CAT("SoftBody::buildLODs", "load");
+    setLOD(0);
+    levels.clear();
+    levels.resize(std::max(count, 1));
+    if (edges.empty()) return;
+
+    std::vector<vec3> fullPositions(tVertexCount);
+    std::vector<ivec4> fullTets(tetraCount);
+    for (const auto& v : vertices) fullPositions[v.vID] = v.position;
+    for (const auto& t : tetras) fullTets[t.tID] = ivec4(t.x1, t.x2, t.x3, t.x4);
+    float cell = 0;
+    for (const auto& e : edges) cell += e.restLength;
+    cell /= edges.size();
+    buildTetBVH();
+    BVH fullBVH = tetBVH;
+
+    for (int k = 1; k < (int)levels.size(); ++k) {
+        cell *= coarsening;
+        ProcMesh::TetMesh tm = ProcMesh::cage(fullPositions, fullTets, cell);
+        Level& level = levels[k];
+        for (const auto& v : tm.vertices) level.vertices.emplace_back(level.vertices.size(), v);
+        for (const auto& e : tm.edges) level.edges.emplace_back(level.edges.size(), e.x, e.y);
+        for (const auto& t : tm.tetras) level.tetras.emplace_back(level.tetras.size(), t.x, t.y, t.z, t.w);
+        for (const auto& n : tm.neighbours) level.tetraNeighbours.emplace_back(n.x, n.y, n.z, n.w);
+
+        // set the cage up in place of level 0, which waits in its slot
+        swapLevel(level);
+        initPhysics();
+        computeSkinningInfo();
+        embed(fullPositions, vertices, tetras, tetBVH, level.fullIn);
+
+        // weights from level 0 for the cage's vertices: barycentric for those inside level 0's mesh. the rest are fit to the level 0 vertices
+        // around them with an affine map, as extrapolating from the nearest tetrahedron magnifies its deformation
+        std::vector<vec3> positions(tVertexCount);
+        for (const auto& v : vertices) positions[v.vID] = v.position;
+        std::vector<std::pair<int, vec4>> inFull;
+        embed(positions, level.vertices, level.tetras, fullBVH, inFull);
+        std::vector<std::vector<int>> around(tVertexCount);  // level 0 vertices in the cage tetrahedra around each cage vertex
+        for (int j = 0; j < (int)fullPositions.size(); ++j) {
+            const Tetra& tet = tetras[level.fullIn[j].first];
+            for (int c = 0; c < 4; ++c) around[tet.corner(c)].push_back(j);
+        }
+        // cage vertices at the corners of the mesh's bounds can have only a few level 0 vertices around them, so those also take their neighbours'
+        std::vector<std::vector<int>> adjacent(tVertexCount);
+        for (const auto& e : edges) {
+            adjacent[e.x1].push_back(e.x2);
+            adjacent[e.x2].push_back(e.x1);
+        }
+        level.inFullOffsets.assign(1, 0);
+        level.inFull.clear();
+        for (int i = 0; i < tVertexCount; ++i) {
+            auto [t, b] = inFull[i];
+            const Tetra& tet = level.tetras[t];
+            std::vector<int> js = around[i];
+            if (js.size() < 16) {
+                for (int n : adjacent[i]) js.insert(js.end(), around[n].begin(), around[n].end());
+                std::sort(js.begin(), js.end());
+                js.erase(std::unique(js.begin(), js.end()), js.end());
+            }
+            if (min(min(b.x, b.y), min(b.z, b.w)) >= -1e-4f || js.empty()) {
+                for (int c = 0; c < 4; ++c) level.inFull.push_back({tet.corner(c), b[c]});
+            } else {
+                // least squares affine fit, evaluated at this vertex's rest position. regularised towards a pure translation when the points are nearly flat
+                vec3 mean = vec3(0);
+                for (int j : js) mean += fullPositions[j];
+                mean /= js.size();
+                mat3 A = mat3(0);
+                for (int j : js) {
+                    vec3 d = fullPositions[j] - mean;
+                    A += mat3(d * d.x, d * d.y, d * d.z);
+                }
+                A += mat3(1e-5f * (A[0][0] + A[1][1] + A[2][2]) + 1e-12f);
+                vec3 q = inverse(A) * (positions[i] - mean);
+                for (int j : js) level.inFull.push_back({j, 1.f / js.size() + dot(fullPositions[j] - mean, q)});
+            }
+            level.inFullOffsets.push_back(level.inFull.size());
+        }
+
+        // those weights alone do not undo interpolating level 0 back out of the cage, so a multigrid correction carried down through `fullIn`
+        // would partly be seen again by the next restriction and applied again. restrict by least squares through `fullIn` instead, leaning
+        // on the fit above only slightly, for cage vertices with little of level 0 around them: (P^T P + eps I) c = P^T x + eps fit(x)
+        std::vector<std::vector<std::pair<int, float>>> rows(tVertexCount);
+        std::vector<std::tuple<int, int, double>> normal;
+        double diagonal = 0;
+        for (int j = 0; j < (int)fullPositions.size(); ++j) {
+            auto [t, b] = level.fullIn[j];
+            const Tetra& tet = tetras[t];
+            for (int c = 0; c < 4; ++c) {
+                rows[tet.corner(c)].push_back({j, b[c]});
+                for (int d = 0; d <= c; ++d) normal.push_back({tet.corner(c), tet.corner(d), (double)b[c] * b[d]});
+                diagonal += (double)b[c] * b[c];
+            }
+        }
+        float eps = 1e-3f * diagonal / tVertexCount;
+        std::vector<int> offsets(1, 0);
+        std::vector<std::pair<int, float>> weights;
+        for (int i = 0; i < tVertexCount; ++i) {
+            normal.push_back({i, i, eps});
+            weights.insert(weights.end(), rows[i].begin(), rows[i].end());
+            for (int k = level.inFullOffsets[i]; k < level.inFullOffsets[i + 1]; ++k) weights.push_back({level.inFull[k].first, eps * level.inFull[k].second});
+            offsets.push_back(weights.size());
+        }
+        level.inFullOffsets = std::move(offsets);
+        level.inFull = std::move(weights);
+        level.restriction.factor(tVertexCount, normal);
+
+        // rest at what level 0's rest pose restricts to, so the multigrid pass does not pull an undeformed body towards the fit's small error
+        interpolate(level, level.vertices, vertices);
+        for (auto& v : vertices) v.invMass = 0;
+        initPhysics();
+        swapLevel(level);
+    }
+    tetBVH = fullBVH;
+    // by default, each level is used from twice the distance of the previous
+    for (int k = lodDistances.size(); k + 1 < (int)levels.size(); ++k) lodDistances.push_back(k == 0 ? 20 : lodDistances.back() * 2);
+}
+
+// exchange the active tetrahedral mesh with `level`
+void SoftBody::swapLevel(Level& level) {
+    std::swap(vertices, level.vertices);
+    std::swap(edges, level.edges);
+    std::swap(tetras, level.tetras);
+    std::swap(tetraNeighbours, level.tetraNeighbours);
+    std::swap(tetraMap, level.tetraMap);
+    std::swap(restShapes, level.restShapes);
+    std::swap(restPositions, level.restPositions);
+    std::swap(projective, level.projective);
+    tetRotations.clear();
+    clusterOffsets.clear();
+    partitionEdgeOffsets.clear();
+    tetraCount = tetras.size();
+    tVertexCount = vertices.size();
+    tvIndices.resize(tVertexCount);
+    std::iota(tvIndices.begin(), tvIndices.end(), 0);
+    previousPositions.resize(tVertexCount);
+}
+
+// set each level 0 vertex from the corners of the coarse level's tetrahedron it is embedded in
+static void interpolate(const std::vector<std::pair<int, vec4>>& embedding, const std::vector<SoftBody::Vertex>& from, const std::vector<SoftBody::Tetra>& tetras,
+                        std::vector<SoftBody::Vertex>& to) {
+    std::for_each(std::execution::par, to.begin(), to.end(), [&](auto&& v) {
+        auto [t, b] = embedding[v.vID];
+        const SoftBody::Tetra& tet = tetras[t];
+        v.position = v.velocity = vec3(0);
+        for (int k = 0; k < 4; ++k) {
+            v.position += b[k] * from[tet.corner(k)].position;
+            v.velocity += b[k] * from[tet.corner(k)].velocity;
+        }
+    });
+}
+
+// switch the simulation to another level, carrying positions and velocities over by barycentric interpolation.
+// coarse levels are only embedded in level 0, so switching between two of them goes through it
+void SoftBody::setLOD(int level) {
+    if (level == lod || level < 0 || level >= (int)levels.size()) return;
+    TRACE_SCOPE_CAT("SoftBody::setLOD", "sim");
+    if (lod != 0 && level != 0) {
+        setLOD(0);
+        return setLOD(level);
+    }
+    releaseGrab();
+    if (lod == 0) interpolate(levels[level], vertices, levels[level].vertices);
+    else interpolate(levels[lod].fullIn, vertices, tetras, levels[0].vertices);
+    swapLevel(levels[lod]);
+    swapLevel(levels[level]);
+    lod = level;
+
+    // vertices interpolated from outside the old level's mesh can start inside the floor or an obstacle. push them out before the next step,
+    // so the push does not become velocity
+    auto settle = [&] {
+        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) { previousPositions[i] = vertices[i].position; });
+    };
+    settle();
+    constrainBounds();
+    settle();
+
+    // data derived from the old level's topology is rebuilt when next needed
+    tetBVH = BVH();
+    surfaceFaces.clear();
+    surfaceVertices.clear();
+    surfaceDirty = true;
+    contactNormals.clear();
+    grabTetras.clear();
+    grabEdges.clear();
+    if (positionStream) {
+        delete positionStream;
+        positionStream = nullptr;
+        glDeleteBuffers(1, &tetraMapSSBO);
+        glDeleteBuffers(1, &tetraSSBO);
+        tetraMapSSBO = tetraSSBO = 0;
+    }
+}
+
+// solve each coarse level's constraints, coarsest first, and add the change to the level 0 vertices embedded in it.
+// a coarse tetrahedron spans many fine ones, so a correction crosses the body in a few iterations rather than one edge per iteration
+void SoftBody::solveCoarse() {
+    TRACE_SCOPE_CAT("SoftBody::solveCoarse", "sim");
+    for (int k = levels.size() - 1; k >= 1; --k) {
+        Level& level = levels[k];
+        interpolate(level, vertices, level.vertices, false);  // the cage's velocities are never read
+        coarseStart.resize(level.vertices.size());
+        for (const auto& v : level.vertices) coarseStart[v.vID] = v.position;
+        // the cage knows nothing of contacts or pins, so it holds still wherever level 0 is held: around pinned vertices and those that touched
+        // a plane or box last substep. otherwise it would push them into what holds them, and the push back would become velocity.
+        // sequential, as many level 0 vertices share each cage vertex
+        coarseInvMass.resize(level.vertices.size());
+        for (const auto& v : level.vertices) coarseInvMass[v.vID] = v.invMass;
+        for (const auto& v : vertices) {
+            bool held = v.invMass == 0 || (v.vID < (int)contactNormals.size() && contactNormals[v.vID] != vec3(0));
+            if (!held) continue;
+            auto [t, b] = level.fullIn[v.vID];
+            const Tetra& tet = level.tetras[t];
+            for (int c = 0; c < 4; ++c) {
+                if (b[c] > 0) level.vertices[tet.corner(c)].invMass = 0;
+            }
+        }
+
+        // solve the level in place of level 0, as when it is active
+        std::swap(vertices, level.vertices);
+        std::swap(edges, level.edges);
+        std::swap(tetras, level.tetras);
+        // edges only: a cage's tetrahedra partly cover empty space, so holding their volumes fights level 0's volume pass and feeds energy in
+        for (int i = 0; i < coarseIterations; ++i) solveEdgeConstraint();
+        std::swap(vertices, level.vertices);
+        std::swap(edges, level.edges);
+        std::swap(tetras, level.tetras);
+        for (auto& v : level.vertices) v.invMass = coarseInvMass[v.vID];
+
+        std::for_each(std::execution::par, vertices.begin(), vertices.end(), [&](auto&& v) {
+            if (v.invMass == 0) return;
+            auto [t, b] = level.fullIn[v.vID];
+            const Tetra& tet = level.tetras[t];
+            for (int c = 0; c < 4; ++c) v.position += b[c] * (level.vertices[tet.corner(c)].position - coarseStart[tet.corner(c)]);
+        });
+    }
+}
+
+// distance from `p` (in world space) to the centre of the body's vertices
+float SoftBody::distanceTo(vec3 p) {
+    vec3 centre = std::transform_reduce(std::execution::par_unseq, vertices.begin(), vertices.end(), vec3(0), std::plus<>(),
+                                        [](const Vertex& v) { return v.position; });
+    centre /= std::max(tVertexCount, 1);
+    return distance(p, vec3(transform * vec4(centre, 1)));
+}
+
+// level to simulate at for a camera at `cameraPos`. the camera has to come `lodHysteresis` back past a distance before a finer level is picked,
+// so a body near a threshold does not switch every frame
+int SoftBody::selectLOD(vec3 cameraPos) {
+    if (levels.size() < 2) return lod;
+    float d = distanceTo(cameraPos);
+    int level = 0;
+    while (level + 1 < (int)levels.size() && level < (int)lodDistances.size()) {
+        float threshold = lodDistances[level] * (level < lod ? 1 - lodHysteresis : 1);
+        if (d < threshold) break;
+        level++;
+    }
+    return level;
+}
+
+int SoftBody::levelTetraCount(int level) {
+    return level == lod ? tetraCount : levels[level].tetras.size();
+}
+
+void SoftBody::solveEdgeConstraint() {
+    TRACE_SCOPE_CAT("SoftBody::solveEdgeConstraint", "sim");
+    std::for_each(std::execution::par, edges.begin(), edges.end(), [&](auto&& e) { solveEdge(e); });
+}
+
 void SoftBody::solveVolumeConstraint() {
+    TRACE_SCOPE_CAT("SoftBody::solveVolumeConstraint", "sim");
+    std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](auto&& tet) { solveTetra(tet); });
+}
+
+// project the distance constraint of edge `e`
+void SoftBody::solveEdge(const Edge& e) {
+    if (vertices[e.x1].invMass + vertices[e.x2].invMass == 0) return;
+    vec3 offset_i = vertices[e.x1].position - vertices[e.x2].position;
+    vec3 offset_j = -offset_i;
+    float l = length(offset_i);
+    if (l == 0) return;  // no direction to push in, e.g. both ends stopped at the same contact point
+    float C = l - e.restLength;
+    vec3 dxi = normalize(offset_i);  // constraint gradient for i
+    vec3 dxj = normalize(offset_j);  // constraint gradient for j
+    float denom = (vertices[e.x1].invMass) +
+                  (vertices[e.x2].invMass) +
+                  (edgeCompliance / (sdt * sdt));
+    // denom += 1e-3f;  // to avoid division by 0. also needs the timestep needs to be low enough to avoid NaN values
+    float lambda = -C / denom;
+    vertices[e.x1].position += lambda * vertices[e.x1].invMass * dxi;
+    vertices[e.x2].position += lambda * vertices[e.x2].invMass * dxj;
+}
+
+// project the volume constraint of tetrahedron `tet`
+void SoftBody::solveTetra(const Tetra& tet) {
     float alpha = volumeCompliance / sdt / sdt;
-    std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](auto&& tet) {
-        Vertex v1 = vertices[tet.x1];
-        Vertex v2 = vertices[tet.x2];
-        Vertex v3 = vertices[tet.x3];
-        Vertex v4 = vertices[tet.x4];
-        vec3 grad1 = cross(v4.position - v2.position, v3.position - v2.position) * 1.f/6.f; // constraint gradient for vertex v1
-        vec3 grad2 = cross(v3.position - v1.position, v4.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v2
-        vec3 grad3 = cross(v4.position - v1.position, v2.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v3
-        vec3 grad4 = cross(v2.position - v1.position, v3.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v4
-        float denom = v1.invMass * length2(grad1);
-        denom += v2.invMass * length2(grad2);
-        denom += v3.invMass * length2(grad3);
-        denom += v4.invMass * length2(grad4);
-        if (denom == 0) return;
-        denom += alpha;
-        float vol = computeTetraVolume(v1.position, v2.position, v3.position, v4.position);
-        float C = vol - tet.restVolume;
+    Vertex v1 = vertices[tet.x1];
+    Vertex v2 = vertices[tet.x2];
+    Vertex v3 = vertices[tet.x3];
+    Vertex v4 = vertices[tet.x4];
+    vec3 grad1 = cross(v4.position - v2.position, v3.position - v2.position) * 1.f/6.f; // constraint gradient for vertex v1
+    vec3 grad2 = cross(v3.position - v1.position, v4.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v2
+    vec3 grad3 = cross(v4.position - v1.position, v2.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v3
+    vec3 grad4 = cross(v2.position - v1.position, v3.position - v1.position) * 1.f/6.f; // constraint gradient for vertex v4
+    float denom = v1.invMass * length2(grad1);
+    denom += v2.invMass * length2(grad2);
+    denom += v3.invMass * length2(grad3);
+    denom += v4.invMass * length2(grad4);
+    if (denom == 0) return;
+    denom += alpha;
+    float vol = computeTetraVolume(v1.position, v2.position, v3.position, v4.position);
+    float C = vol - tet.restVolume;
+    float lambda = -C / denom;
+    vertices[tet.x1].position += lambda * v1.invMass * grad1;
+    vertices[tet.x2].position += lambda * v2.invMass * grad2;
+    vertices[tet.x3].position += lambda * v3.invMass * grad3;
+    vertices[tet.x4].position += lambda * v4.invMass * grad4;
+}
+
+// greedy colouring of `constraints` (each given by its vertices through `corners`) into batches that share no vertex, so each batch can be solved
+// in parallel without races. up to 64 colours are tracked per vertex; anything left after that goes in a final batch that is solved serially
+template <typename T, typename F>
+static int colourConstraints(const std::vector<int>& constraints, const std::vector<T>& all, F corners, int vertexCount, std::vector<int>& offsets,
+                             std::vector<int>& ordered) {
+    std::vector<uint64_t> used(vertexCount, 0);
+    std::vector<int> colour(constraints.size());
+    int count = 0;
+    for (size_t k = 0; k < constraints.size(); ++k) {
+        uint64_t taken = 0;
+        corners(all[constraints[k]], [&](int v) { taken |= used[v]; });
+        int c = taken == ~0ull ? 64 : std::countr_one(taken);
+        if (c < 64) corners(all[constraints[k]], [&](int v) { used[v] |= 1ull << c; });
+        colour[k] = c;
+        count = std::max(count, c + 1);
+    }
+    offsets.assign(count + 1, 0);
+    for (int c : colour) offsets[c + 1]++;
+    std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+    ordered.resize(constraints.size());
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t k = 0; k < constraints.size(); ++k) ordered[fill[colour[k]]++] = constraints[k];
+    return count;
+}
+
+// split the tetrahedra into clusters of about `partitionSize` by breadth-first search over `tetraNeighbours`, so each cluster is a compact piece
+// of the mesh. each vertex is owned by one cluster, and a constraint whose vertices all have the same owner is interior to it, so interior
+// constraints of different clusters never share a vertex. the constraints across clusters are coloured for the boundary pass
+void SoftBody::initPartitions() {
+    TRACE_SCOPE_CAT("SoftBody::initPartitions", "load");
+    std::vector<int> partitionOf(tetraCount, -1);
+    bool adjacency = (int)tetraNeighbours.size() == tetraCount;
+    if (!adjacency) printf("No tetrahedron neighbours for %s, partitioning by tetrahedron order\n", name.c_str());
+    int size = std::max(1, partitionSize);
+    int count = 0;
+    std::vector<int> queue;
+    for (int seed = 0; seed < tetraCount; ++seed) {
+        if (partitionOf[seed] >= 0) continue;
+        queue.assign(1, seed);
+        partitionOf[seed] = count;
+        for (size_t q = 0; q < queue.size() && (int)queue.size() < size; ++q) {
+            if (!adjacency) {
+                for (int t = queue.back() + 1; t < tetraCount && (int)queue.size() < size && partitionOf[t] < 0; ++t) {
+                    partitionOf[t] = count;
+                    queue.push_back(t);
+                }
+                break;
+            }
+            auto [n1, n2, n3, n4] = tetraNeighbours[queue[q]];
+            for (int n : {n1, n2, n3, n4}) {
+                if (n < 0 || partitionOf[n] >= 0 || (int)queue.size() >= size) continue;
+                partitionOf[n] = count;
+                queue.push_back(n);
+            }
+        }
+        count++;
+    }
+
+    // each vertex is owned by the cluster of the first tetrahedron it is a corner of
+    std::vector<int> owner(tVertexCount, -1);
+    for (const auto& tet : tetras) {
+        for (int k = 0; k < 4; ++k) {
+            if (owner[tet.corner(k)] < 0) owner[tet.corner(k)] = partitionOf[tet.tID];
+        }
+    }
+    auto interior = [&](std::initializer_list<int> vs) {
+        int p = owner[*vs.begin()];
+        for (int v : vs) {
+            if (owner[v] != p) return -1;
+        }
+        return p;
+    };
+
+    std::vector<int> edgePartition(edges.size()), tetraPartition(tetraCount), boundaryE, boundaryT;
+    for (const auto& e : edges) {
+        edgePartition[e.eID] = interior({e.x1, e.x2});
+        if (edgePartition[e.eID] < 0) boundaryE.push_back(e.eID);
+    }
+    for (const auto& tet : tetras) {
+        tetraPartition[tet.tID] = interior({tet.x1, tet.x2, tet.x3, tet.x4});
+        if (tetraPartition[tet.tID] < 0) boundaryT.push_back(tet.tID);
+    }
+    auto bucket = [&](const std::vector<int>& partitionOfItem, std::vector<int>& offsets, std::vector<int>& items) {
+        offsets.assign(count + 1, 0);
+        for (int p : partitionOfItem) {
+            if (p >= 0) offsets[p + 1]++;
+        }
+        std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+        items.resize(offsets.back());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < partitionOfItem.size(); ++i) {
+            if (partitionOfItem[i] >= 0) items[fill[partitionOfItem[i]]++] = i;
+        }
+    };
+    bucket(edgePartition, partitionEdgeOffsets, partitionEdges);
+    bucket(tetraPartition, partitionTetraOffsets, partitionTetras);
+    partitionIDs.resize(count);
+    std::iota(partitionIDs.begin(), partitionIDs.end(), 0);
+
+    int edgeColours = colourConstraints(boundaryE, edges, [](const Edge& e, auto f) { f(e.x1); f(e.x2); }, tVertexCount, boundaryEdgeOffsets, boundaryEdges);
+    int tetraColours = colourConstraints(boundaryT, tetras, [](const Tetra& t, auto f) { f(t.x1); f(t.x2); f(t.x3); f(t.x4); }, tVertexCount,
+                                         boundaryTetraOffsets, boundaryTetras);
+    printf("Built %d partitions: %zu of %zu edges and %zu of %d tetrahedra on boundaries, in %d and %d colours\n", count, boundaryE.size(), edges.size(),
+           boundaryT.size(), tetraCount, edgeColours, tetraColours);
+}
+
+// edge and volume constraints by partition: each thread takes a whole cluster and iterates its interior constraints `partitionIterations` times
+// while its vertices are in cache, then the boundary constraints are solved one colour at a time
+void SoftBody::solvePartitioned() {
+    TRACE_SCOPE_CAT("SoftBody::solvePartitioned", "sim");
+    if (partitionEdgeOffsets.empty()) initPartitions();
+    std::for_each(std::execution::par, partitionIDs.begin(), partitionIDs.end(), [&](int p) {
+        for (int i = 0; i < partitionIterations; ++i) {
+            for (int k = partitionEdgeOffsets[p]; k < partitionEdgeOffsets[p + 1]; ++k) solveEdge(edges[partitionEdges[k]]);
+            for (int k = partitionTetraOffsets[p]; k < partitionTetraOffsets[p + 1]; ++k) solveTetra(tetras[partitionTetras[k]]);
+        }
+    });
+    // the last colour is solved serially if the colouring ran out of colours
+    auto solveColours = [&](const std::vector<int>& offsets, const std::vector<int>& items, auto solveOne) {
+        for (size_t c = 0; c + 1 < offsets.size(); ++c) {
+            auto first = items.begin() + offsets[c], last = items.begin() + offsets[c + 1];
+            if (c < 64) std::for_each(std::execution::par, first, last, solveOne);
+            else std::for_each(first, last, solveOne);
+        }
+    };
+    solveColours(boundaryEdgeOffsets, boundaryEdges, [&](int e) { solveEdge(edges[e]); });
+    solveColours(boundaryTetraOffsets, boundaryTetras, [&](int t) { solveTetra(tetras[t]); });
+}
+
+// gradients of a tetrahedron's deformation gradient with respect to each corner, from the inverse of its rest edge matrix: F = sum of x_k g_k^T
+static void shapeGradients(const mat3& restShape, vec3 g[4]) {
+    for (int c = 0; c < 3; ++c) g[c + 1] = vec3(restShape[0][c], restShape[1][c], restShape[2][c]);
+    g[0] = -(g[1] + g[2] + g[3]);
+}
+
+// rotation about the unit `axis` by `angle`
+static mat3 axisAngle(vec3 axis, float angle) {
+    float c = cos(angle), s = sin(angle), t = 1 - c;
+    vec3 k = axis;
+    return mat3(vec3(t * k.x * k.x + c, t * k.x * k.y + s * k.z, t * k.x * k.z - s * k.y),
+                vec3(t * k.x * k.y - s * k.z, t * k.y * k.y + c, t * k.y * k.z + s * k.x),
+                vec3(t * k.x * k.z + s * k.y, t * k.y * k.z - s * k.x, t * k.z * k.z + c));
+}
+
+// rotational part of `F`, refined from the rotation already in `R` (Mueller et al., "A Robust Method to Extract the Rotational Part of Deformations").
+// unlike a polar decomposition, it stays a rotation when `F` is inverted. the rotation changes little between iterations, so a couple of steps from
+// the last one are enough
+static void extractRotation(const mat3& F, mat3& R, int iterations = 2) {
+    for (int i = 0; i < iterations; ++i) {
+        vec3 omega = cross(R[0], F[0]) + cross(R[1], F[1]) + cross(R[2], F[2]);
+        omega /= std::abs(dot(R[0], F[0]) + dot(R[1], F[1]) + dot(R[2], F[2])) + 1e-9f;
+        float w = length(omega);
+        if (w < 1e-6f) break;
+        R = axisAngle(omega / w, w) * R;
+    }
+    // keep rounding from building up across frames
+    R[0] = normalize(R[0]);
+    R[1] = normalize(R[1] - R[0] * dot(R[0], R[1]));
+    R[2] = cross(R[0], R[1]);
+}
+
+// deviatoric and hydrostatic constraints of every tetrahedron in one pass, so each tetrahedron's corners are read and written once per iteration
+// rather than once by each of its six edges and again by the volume pass. the compliances come from the Lame parameters, and are divided by
+// each tetrahedron's rest volume
+void SoftBody::solveFEMConstraint() {
+    TRACE_SCOPE_CAT("SoftBody::solveFEMConstraint", "sim");
+    float mu = youngsModulus / (2 * (1 + poissonRatio));
+    float lambda = youngsModulus * poissonRatio / ((1 + poissonRatio) * (1 - 2 * poissonRatio));
+    float alphaD = 1 / (2 * mu * sdt * sdt);
+    float alphaH = 1 / (lambda * sdt * sdt);
+    tetRotations.resize(tetras.size(), mat3(1));
+    std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](auto&& tet) { solveFEM(tet, alphaD, alphaH); });
+}
+
+// project the constraints of a corotated material on tetrahedron `tet`: deviatoric C_D = |F - R| (R being the rotation of F) and
+// hydrostatic C_H = det(F) - 1. both vanish only at a rotation, so a stiff material can satisfy them together.
+// F = sum of x_k g_k^T, so the gradient of either constraint at corner k is its gradient with respect to F times g_k
+void SoftBody::solveFEM(const Tetra& tet, float alphaD, float alphaH) {
+    if (tet.restVolume <= 0) return;
+    const int ids[4] = {tet.x1, tet.x2, tet.x3, tet.x4};
+    vec3 x[4];
+    float w[4];
+    for (int k = 0; k < 4; ++k) {
+        x[k] = vertices[ids[k]].position;
+        w[k] = vertices[ids[k]].invMass;
+    }
+    if (w[0] + w[1] + w[2] + w[3] == 0) return;
+    vec3 g[4];
+    shapeGradients(restShapes[tet.tID], g);
+
+    auto project = [&](float C, const mat3& dCdF, float alpha) {
+        vec3 grad[4];
+        for (int k = 1; k < 4; ++k) grad[k] = dCdF * g[k];
+        grad[0] = -(grad[1] + grad[2] + grad[3]);
+        float denom = alpha / tet.restVolume;
+        for (int k = 0; k < 4; ++k) denom += w[k] * length2(grad[k]);
         float lambda = -C / denom;
-        vertices[tet.x1].position += lambda * v1.invMass * grad1;
-        vertices[tet.x2].position += lambda * v2.invMass * grad2;
-        vertices[tet.x3].position += lambda * v3.invMass * grad3;
-        vertices[tet.x4].position += lambda * v4.invMass * grad4;
+        for (int k = 0; k < 4; ++k) x[k] += lambda * w[k] * grad[k];
+    };
+    auto deformation = [&]() { return mat3(x[1] - x[0], x[2] - x[0], x[3] - x[0]) * restShapes[tet.tID]; };
+
+    mat3 F = deformation();
+    mat3& R = tetRotations[tet.tID];
+    extractRotation(F, R);
+    mat3 S = F - R;
+    float C = std::sqrt(dot(S[0], S[0]) + dot(S[1], S[1]) + dot(S[2], S[2]));
+    if (C > 1e-6f) project(C, S * (1 / C), alphaD);
+    // the derivative of det(F) is the cofactor matrix, whose columns are cross products of F's columns
+    F = deformation();
+    project(determinant(F) - 1, mat3(cross(F[1], F[2]), cross(F[2], F[0]), cross(F[0], F[1])), alphaH);
+
+    for (int k = 0; k < 4; ++k) {
+        if (w[k] != 0) vertices[ids[k]].position = x[k];
+    }
+}
+
+// group the vertices into overlapping clusters: one for each 2 x 2 x 2 block of cells that has vertices in it, so a vertex is in up to 8 clusters
+// and neighbouring clusters share half their cells. larger cells make the body stiffer and cheaper
+void SoftBody::initClusters() {
+    TRACE_SCOPE_CAT("SoftBody::initClusters", "sim");
+    float size = clusterSize;
+    if (size <= 0) {
+        for (const auto& e : edges) size += e.restLength;
+        size = edges.empty() ? 1 : 4 * size / edges.size();
+    }
+    vec3 low = vec3(FLT_MAX);
+    for (const auto& p : restPositions) low = min(low, p);
+
+    std::unordered_map<long long, int> ids;  // cluster of each block, by its lowest cell
+    std::vector<std::vector<int>> members;
+    vertexClusterOffsets.assign(1, 0);
+    vertexClusters.clear();
+    for (int i = 0; i < tVertexCount; ++i) {
+        ivec3 cell = ivec3(floor((restPositions[i] - low) / size));
+        for (int c = 0; c < 8; ++c) {
+            ivec3 block = cell - ivec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+            auto [it, added] = ids.try_emplace(getHashKey(block), members.size());
+            if (added) members.emplace_back();
+            members[it->second].push_back(i);
+            vertexClusters.push_back(it->second);
+        }
+        vertexClusterOffsets.push_back(vertexClusters.size());
+    }
+    clusterOffsets.assign(1, 0);
+    clusterMembers.clear();
+    for (const auto& m : members) {
+        clusterMembers.insert(clusterMembers.end(), m.begin(), m.end());
+        clusterOffsets.push_back(clusterMembers.size());
+    }
+    int count = members.size();
+    clusterIDs.resize(count);
+    std::iota(clusterIDs.begin(), clusterIDs.end(), 0);
+    clusterRotations.assign(count, mat3(1));
+    clusterCentres.resize(count);
+    clusterRestCentres.resize(count);
+    printf("Built %d shape matching clusters (cell size %.3f)\n", count, size);
+}
+
+// match each cluster's rest shape to where its vertices are (Mueller et al., "Meshless Deformations Based on Shape Matching"): the best rotation
+// is the rotational part of the moment matrix sum of m (x - c)(q - c0)^T. then move each vertex towards the mean of its clusters' goal positions.
+// pinned vertices, and those that touched a plane or box last substep, get a large mass, so the clusters around them follow them rather than
+// pulling them back into what holds them
+void SoftBody::solveShapeMatching() {
+    TRACE_SCOPE_CAT("SoftBody::solveShapeMatching", "sim");
+    if (clusterOffsets.empty()) initClusters();
+    auto mass = [&](int i) {
+        bool held = vertices[i].invMass == 0 || (i < (int)contactNormals.size() && contactNormals[i] != vec3(0));
+        return held ? 1e6f : 1 / vertices[i].invMass;
+    };
+    std::for_each(std::execution::par, clusterIDs.begin(), clusterIDs.end(), [&](int c) {
+        float total = 0;
+        vec3 centre = vec3(0), restCentre = vec3(0);
+        for (int k = clusterOffsets[c]; k < clusterOffsets[c + 1]; ++k) {
+            int i = clusterMembers[k];
+            float m = mass(i);
+            total += m;
+            centre += m * vertices[i].position;
+            restCentre += m * restPositions[i];
+        }
+        centre /= total;
+        restCentre /= total;
+        mat3 A = mat3(0);
+        for (int k = clusterOffsets[c]; k < clusterOffsets[c + 1]; ++k) {
+            int i = clusterMembers[k];
+            A += outerProduct(mass(i) * (vertices[i].position - centre), restPositions[i] - restCentre);
+        }
+        extractRotation(A, clusterRotations[c]);
+        clusterCentres[c] = centre;
+        clusterRestCentres[c] = restCentre;
+    });
+    std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](int i) {
+        if (vertices[i].invMass == 0) return;
+        vec3 goal = vec3(0);
+        for (int k = vertexClusterOffsets[i]; k < vertexClusterOffsets[i + 1]; ++k) {
+            int c = vertexClusters[k];
+            goal += clusterRotations[c] * (restPositions[i] - clusterRestCentres[c]) + clusterCentres[c];
+        }
+        goal /= vertexClusterOffsets[i + 1] - vertexClusterOffsets[i];
+        vertices[i].position += shapeStiffness * (goal - vertices[i].position);
     });
 }
 
+// assemble and factor the global matrix of projective dynamics: each vertex's mass over h^2 on the diagonal, plus w G^T G for each tetrahedron,
+// where G maps its corners to its deformation gradient and w is its stiffness times its rest volume
+void SoftBody::initProjective() {
+    TRACE_SCOPE_CAT("SoftBody::initProjective", "load");
+    ProjectiveSystem& ps = projective;
+    ps.step = sdt;
+    ps.stiffness = projectiveStiffness;
+    std::vector<std::tuple<int, int, double>> entries;
+    entries.reserve(tVertexCount + tetraCount * 10);
+    std::vector<double> diagonal(tVertexCount, 0);
+    for (const auto& tet : tetras) {
+        vec3 g[4];
+        shapeGradients(restShapes[tet.tID], g);
+        double w = (double)projectiveStiffness * std::abs(tet.restVolume);
+        for (int a = 0; a < 4; ++a) {
+            for (int b = 0; b <= a; ++b) entries.push_back({tet.corner(a), tet.corner(b), w * dot(g[a], g[b])});
+            diagonal[tet.corner(a)] += w * dot(g[a], g[a]);
+        }
+    }
+    // pinned vertices are held by a mass far above anything around them
+    double h2 = (double)sdt * sdt;
+    double pinned = 0;
+    for (const auto& v : vertices) pinned = std::max(pinned, v.invMass > 0 ? 1 / (v.invMass * h2) : 0);
+    pinned = 1e6 * std::max(pinned, *std::max_element(diagonal.begin(), diagonal.end()));
+    ps.inertia.resize(tVertexCount);
+    for (const auto& v : vertices) {
+        ps.inertia[v.vID] = v.invMass > 0 ? 1 / (v.invMass * h2) : pinned;
+        entries.push_back({v.vID, v.vID, ps.inertia[v.vID]});
+    }
+    if (!ps.cholesky.factor(tVertexCount, entries)) {
+        printf("Failed to factor projective dynamics system for %s, using XPBD\n", name.c_str());
+        backend = XPBD;
+        return;
+    }
+
+    ps.incidentOffsets.assign(tVertexCount + 1, 0);
+    for (const auto& tet : tetras) {
+        for (int c = 0; c < 4; ++c) ps.incidentOffsets[tet.corner(c) + 1]++;
+    }
+    std::inclusive_scan(ps.incidentOffsets.begin(), ps.incidentOffsets.end(), ps.incidentOffsets.begin());
+    ps.incident.resize(ps.incidentOffsets.back());
+    std::vector<int> fill(ps.incidentOffsets.begin(), ps.incidentOffsets.end() - 1);
+    for (const auto& tet : tetras) {
+        for (int c = 0; c < 4; ++c) ps.incident[fill[tet.corner(c)]++] = {tet.tID, c};
+    }
+    printf("Factored projective dynamics system for %s (%d vertices, %zu stored entries)\n", name.c_str(), tVertexCount, ps.cholesky.values.size());
+}
+
+// projective dynamics: alternate a local step, which finds the rotation closest to each tetrahedron's deformation, with a global step, which finds
+// the positions that best match those rotations and the inertial positions together. the global matrix never changes, so that step is only
+// a forward and a back substitution per axis
+void SoftBody::solveProjective() {
+    TRACE_SCOPE_CAT("SoftBody::solveProjective", "sim");
+    if (projective.cholesky.empty() || projective.step != sdt || projective.stiffness != projectiveStiffness) initProjective();
+    if (projective.cholesky.empty()) return;
+    const ProjectiveSystem& ps = projective;
+    inertialPositions.resize(tVertexCount);
+    std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) { inertialPositions[i] = vertices[i].position; });
+    tetRotations.resize(tetraCount, mat3(1));
+    projectiveRHS.resize(3 * tVertexCount);
+    int axes[3] = {0, 1, 2};
+    for (int it = 0; it < projectiveIterations; ++it) {
+        // local step. every tetrahedron is independent
+        std::for_each(std::execution::par, tetras.begin(), tetras.end(), [&](auto&& tet) {
+            vec3 p1 = vertices[tet.x1].position;
+            mat3 Ds = mat3(vertices[tet.x2].position - p1, vertices[tet.x3].position - p1, vertices[tet.x4].position - p1);
+            extractRotation(Ds * restShapes[tet.tID], tetRotations[tet.tID]);
+        });
+        // right-hand sides, gathered per vertex from the tetrahedra around it
+        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+            dvec3 b = dvec3(inertialPositions[i]) * ps.inertia[i];
+            for (int k = ps.incidentOffsets[i]; k < ps.incidentOffsets[i + 1]; ++k) {
+                auto [t, c] = ps.incident[k];
+                vec3 g[4];
+                shapeGradients(restShapes[t], g);
+                b += dvec3(tetRotations[t] * g[c]) * ((double)projectiveStiffness * std::abs(tetras[t].restVolume));
+            }
+            for (int a = 0; a < 3; ++a) projectiveRHS[a * tVertexCount + i] = b[a];
+        });
+        // global step
+        std::for_each(std::execution::par, axes, axes + 3, [&](int a) { ps.cholesky.solve(&projectiveRHS[a * tVertexCount]); });
+        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+            if (vertices[i].invMass == 0) return;
+            vertices[i].position = vec3(projectiveRHS[i], projectiveRHS[tVertexCount + i], projectiveRHS[2 * tVertexCount + i]);
+        });
+    }
+}
+
+// extra iterations over the constraints near the grabbed vertex, so the region around the cursor settles without raising the substeps for the whole body
+void SoftBody::solveGrabRegion() {
+    TRACE_SCOPE_CAT("SoftBody::solveGrabRegion", "sim");
+    for (int it = 0; it < grabIterations; ++it) {
+        std::for_each(std::execution::par, grabEdges.begin(), grabEdges.end(), [&](auto&& i) { solveEdge(edges[i]); });
+        std::for_each(std::execution::par, grabTetras.begin(), grabTetras.end(), [&](auto&& i) { solveTetra(tetras[i]); });
+    }
+}
+
+// collect the surface vertices and the edge adjacency used to skip connected pairs
+void SoftBody::initSelfCollision() {
+    TRACE_SCOPE_CAT("SoftBody::initSelfCollision", "load");
+    if (surfaceFaces.empty()) initSurface();
+    std::vector<char> onSurface(tVertexCount, 0);
+    for (const auto& f : surfaceFaces) {
+        for (int k = 0; k < 3; ++k) onSurface[f.v[k]] = 1;
+    }
+    surfaceVertices.clear();
+    for (int i = 0; i < tVertexCount; ++i) {
+        if (onSurface[i]) surfaceVertices.push_back(i);
+    }
+    svIndices.resize(surfaceVertices.size());
+    std::iota(svIndices.begin(), svIndices.end(), 0);
+
+    // count edges per vertex, prefix sum into offsets, then fill and sort each vertex's list for binary searching
+    neighbourOffsets.assign(tVertexCount + 1, 0);
+    for (const auto& e : edges) {
+        neighbourOffsets[e.x1 + 1]++;
+        neighbourOffsets[e.x2 + 1]++;
+    }
+    std::inclusive_scan(neighbourOffsets.begin(), neighbourOffsets.end(), neighbourOffsets.begin());
+    neighbours.resize(neighbourOffsets.back());
+    std::vector<int> fill(neighbourOffsets.begin(), neighbourOffsets.end() - 1);
+    for (const auto& e : edges) {
+        neighbours[fill[e.x1]++] = e.x2;
+        neighbours[fill[e.x2]++] = e.x1;
+    }
+    std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+        std::sort(neighbours.begin() + neighbourOffsets[i], neighbours.begin() + neighbourOffsets[i + 1]);
+    });
+
+    if (selfCollisionDist <= 0 && !edges.empty()) {
+        float total = 0;
+        for (const auto& e : edges) total += e.restLength;
+        selfCollisionDist = 0.5f * total / edges.size();
+    }
+    tableSize = 2 * surfaceVertices.size();
+    cellStart.resize(tableSize + 1);
+    cellEntries.resize(surfaceVertices.size());
+    vertexHashes.resize(surfaceVertices.size());
+    selfCorrections.resize(surfaceVertices.size());
+}
+
+// bucket the surface vertices by hash cell with a parallel counting sort: count per cell, scan into offsets, then scatter
+void SoftBody::buildSelfCollisionHash() {
+    TRACE_SCOPE_CAT("SoftBody::buildSelfCollisionHash", "sim");
+    std::vector<int> counts(tableSize + 1, 0);
+    std::for_each(std::execution::par, svIndices.begin(), svIndices.end(), [&](int i) {
+        ivec3 cell = ivec3(floor(vertices[surfaceVertices[i]].position / selfCollisionDist));
+        vertexHashes[i] = std::abs(getHashKey(cell)) % tableSize;
+        std::atomic_ref<int>(counts[vertexHashes[i]]).fetch_add(1, std::memory_order_relaxed);
+    });
+    // counts become start offsets, with the total in the extra last entry
+    std::exclusive_scan(std::execution::par, counts.begin(), counts.end(), cellStart.begin(), 0);
+    std::vector<int>& cursor = counts;  // next free slot of each cell
+    std::copy(std::execution::par_unseq, cellStart.begin(), cellStart.end(), cursor.begin());
+    std::for_each(std::execution::par, svIndices.begin(), svIndices.end(), [&](int i) {
+        int slot = std::atomic_ref<int>(cursor[vertexHashes[i]]).fetch_add(1, std::memory_order_relaxed);
+        cellEntries[slot] = i;
+    });
+}
+
+// push apart surface vertices closer than `selfCollisionDist` that are not joined by an edge.
+// each vertex gathers its own share of every contact, so the corrections are applied Jacobi-style without atomics
+void SoftBody::solveSelfCollision() {
+    TRACE_SCOPE_CAT("SoftBody::solveSelfCollision", "sim");
+    if (surfaceVertices.empty()) initSelfCollision();
+    buildSelfCollisionHash();
+    float d = selfCollisionDist;
+    std::for_each(std::execution::par, svIndices.begin(), svIndices.end(), [&](int i) {
+        int a = surfaceVertices[i];
+        selfCorrections[i] = vec3(0);
+        float wa = vertices[a].invMass;
+        if (wa == 0) return;
+        vec3 pa = vertices[a].position;
+        ivec3 lcell = ivec3(floor((pa - d) / d));
+        ivec3 hcell = ivec3(floor((pa + d) / d));
+        auto nStart = neighbours.begin() + neighbourOffsets[a];
+        auto nEnd = neighbours.begin() + neighbourOffsets[a + 1];
+        vec3 correction = vec3(0);
+        int contacts = 0;
+        for (int x = lcell.x; x <= hcell.x; ++x) {
+            for (int y = lcell.y; y <= hcell.y; ++y) {
+                for (int z = lcell.z; z <= hcell.z; ++z) {
+                    int h = std::abs(getHashKey(ivec3(x, y, z))) % tableSize;
+                    for (int e = cellStart[h]; e < cellStart[h + 1]; ++e) {
+                        int b = surfaceVertices[cellEntries[e]];
+                        if (b == a) continue;
+                        vec3 offset = pa - vertices[b].position;
+                        float l2 = length2(offset);
+                        if (l2 >= d * d || l2 == 0) continue;
+                        if (std::binary_search(nStart, nEnd, b)) continue;  // adjacent
+                        float l = sqrt(l2);
+                        float wb = vertices[b].invMass;
+                        correction += offset / l * ((d - l) * wa / (wa + wb));
+                        contacts++;
+                    }
+                }
+            }
+        }
+        if (contacts > 0) selfCorrections[i] = correction / (float)contacts;
+    });
+    std::for_each(std::execution::par, svIndices.begin(), svIndices.end(), [&](int i) { vertices[surfaceVertices[i]].position += selfCorrections[i]; });
+}
+
 void SoftBody::updateVisualMesh() {
+    TRACE_SCOPE_CAT("SoftBody::updateVisualMesh", "sim");
+    // write straight into the mesh's mapped stream when it has one, otherwise into its vertices for uploading
+    vec3* out = mesh->p_Stream ? (vec3*)mesh->p_Stream->map() : nullptr;
+    // normals read the positions back, which is slow from mapped memory, so also keep them in `mesh->vertices`
+    bool keepCopy = out && recomputeNormals;
+    if (!out) out = mesh->vertices.data();
     std::for_each(std::execution::par, mvIndices.begin(), mvIndices.end(), [&](auto&& i) {
         auto [tID, b] = tetraMap[i];
         vec4 bary = vec4(b, 1 - b.x - b.y - b.z);
-        mesh->vertices[i] = 
+        vec3 p =
             (vertices[tetras[tID].x1].position * bary.x) + 
             (vertices[tetras[tID].x2].position * bary.y) + 
             (vertices[tetras[tID].x3].position * bary.z) + 
             (vertices[tetras[tID].x4].position * bary.w);
+        out[i] = p;
+        if (keepCopy) mesh->vertices[i] = p;
     });
+    if (recomputeNormals) updateNormals(mesh->vertices.data());
+}
+
+// build the visual mesh's vertex-to-triangle adjacency, in CSR form
+void SoftBody::initNormals() {
+    TRACE_SCOPE_CAT("SoftBody::initNormals", "load");
+    triangles.clear();
+    for (const auto& m : mesh->meshes) {
+        for (unsigned int i = m.baseIndex; i + 2 < m.baseIndex + m.n_Indices; i += 3) {
+            triangles.push_back(ivec3(mesh->indices[i], mesh->indices[i + 1], mesh->indices[i + 2]) + (int)m.baseVertex);
+        }
+    }
+    faceNormals.resize(triangles.size());
+    triIndices.resize(triangles.size());
+    std::iota(triIndices.begin(), triIndices.end(), 0);
+    mesh->normals.resize(mVertexCount);
+
+    // count triangles per vertex, prefix sum into offsets, then fill
+    vertexTriOffsets.assign(mVertexCount + 1, 0);
+    for (const auto& t : triangles) {
+        for (int k = 0; k < 3; ++k) vertexTriOffsets[t[k] + 1]++;
+    }
+    std::inclusive_scan(vertexTriOffsets.begin(), vertexTriOffsets.end(), vertexTriOffsets.begin());
+    vertexTris.resize(vertexTriOffsets.back());
+    std::vector<int> fill(vertexTriOffsets.begin(), vertexTriOffsets.end() - 1);
+    for (int f = 0; f < (int)triangles.size(); ++f) {
+        for (int k = 0; k < 3; ++k) vertexTris[fill[triangles[f][k]]++] = f;
+    }
+}
+
+// recompute visual mesh normals from deformed `positions`. face normals are computed first, then gathered per vertex, so neither pass needs atomics
+void SoftBody::updateNormals(const vec3* positions) {
+    TRACE_SCOPE_CAT("SoftBody::updateNormals", "sim");
+    if (vertexTriOffsets.empty()) initNormals();
+    std::for_each(std::execution::par_unseq, triIndices.begin(), triIndices.end(), [&](int f) {
+        const ivec3& t = triangles[f];
+        vec3 p0 = positions[t.x];
+        faceNormals[f] = cross(positions[t.y] - p0, positions[t.z] - p0);  // length is twice the area
+    });
+    vec3* out = mesh->n_Stream ? (vec3*)mesh->n_Stream->map() : nullptr;
+    if (!out) out = mesh->normals.data();
+    std::for_each(std::execution::par_unseq, mvIndices.begin(), mvIndices.end(), [&](int i) {
+        vec3 n = vec3(0);
+        for (int j = vertexTriOffsets[i]; j < vertexTriOffsets[i + 1]; ++j) n += faceNormals[vertexTris[j]];
+        float l = length(n);
+        out[i] = l > 0 ? n / l : Util::UP;
+    });
+}
+
+// upload the static embedding data used by softBody.vert. requires an OpenGL context
+void SoftBody::initGPUSkinning() {
+    TRACE_SCOPE_CAT("SoftBody::initGPUSkinning", "load");
+    // std430 layouts of `Embedding` and `ivec4` in softBody.vert
+    struct Embedding {
+        vec3 bary;
+        int tID;
+    };
+    std::vector<Embedding> embeddings(mVertexCount);
+    for (int i = 0; i < mVertexCount; ++i) embeddings[i] = {tetraMap[i].second, tetraMap[i].first};
+    std::vector<ivec4> tets(tetraCount);
+    for (int i = 0; i < tetraCount; ++i) tets[i] = ivec4(tetras[i].x1, tetras[i].x2, tetras[i].x3, tetras[i].x4);
+
+    glCreateBuffers(1, &tetraMapSSBO);
+    glCreateBuffers(1, &tetraSSBO);
+    glNamedBufferStorage(tetraMapSSBO, sizeof(Embedding) * embeddings.size(), embeddings.data(), 0);
+    glNamedBufferStorage(tetraSSBO, sizeof(ivec4) * tets.size(), tets.data(), 0);
+
+    GLint alignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    positionStream = new StreamBuffer(sizeof(vec4) * tVertexCount, nullptr, alignment);
+}
+
+// draw the visual mesh with `shader` if the body is visible, embedding it in the tetrahedral mesh on the GPU if `gpuSkinning` is enabled
+void SoftBody::render(Shader* shader, mat4 model) {
+    if (!visible) return;
+    if (!gpuSkinning) {
+        mesh->render(model);
+        return;
+    }
+    if (!positionStream) initGPUSkinning();
+    vec4* out = (vec4*)positionStream->map();
+    if (!out) {
+        gpuSkinning = false;
+        mesh->render(model);
+        return;
+    }
+    {
+        TRACE_SCOPE_CAT("SoftBody::uploadPositions", "render");
+        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+            out[i] = vec4(vertices[i].position, 1);
+        });
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_TETRAMAP_BINDING, tetraMapSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SB_TETRA_BINDING, tetraSSBO);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, SB_POSITION_BINDING, positionStream->ID, positionStream->offset(), positionStream->size);
+    shader->setBool("gpuSkinning", true);
+    mesh->render(model);
+    shader->setBool("gpuSkinning", false);
+    positionStream->fence();
 }
 
 void SoftBody::applyForces() {
+    TRACE_SCOPE_CAT("SoftBody::applyForces", "sim");
     std::for_each(std::execution::par, vertices.begin(), vertices.end(), [&](auto&& v) {
         if (v.invMass == 0) return;
         v.velocity += Util::DOWN * gravity * sdt;
     });
 }
 
+// sweep each vertex's substep motion against the floor, the planes and the boxes, stopping it at the first surface it crosses rather than
+// fixing it up after it has gone through, then push it out of any SDF colliders
 void SoftBody::constrainBounds() {
-    std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
-        if (vertices[i].position.y < floorY) {
-            vertices[i].position = previousPositions[i];
-            vertices[i].position.y = floorY;
+    TRACE_SCOPE_CAT("SoftBody::constrainBounds", "sim");
+    mat4 toBody = inverse(transform);
+    // planes in the body's space, starting with the floor
+    std::vector<Plane> bodyPlanes = {{Util::UP, floorY}};
+    for (const Plane& pl : planes) {
+        vec3 n = normalize(mat3(toBody) * pl.normal);
+        vec3 onPlane = vec3(toBody * vec4(pl.normal * pl.offset, 1));
+        bodyPlanes.push_back({n, dot(n, onPlane)});
+    }
+    // body space <-> collider space, once per collider rather than per vertex
+    std::vector<std::pair<mat4, mat4>> toCollider(colliders.size());
+    for (size_t c = 0; c < colliders.size(); ++c) {
+        toCollider[c].first = colliders[c]->invTransform * transform;
+        toCollider[c].second = inverse(toCollider[c].first);
+    }
+    contactNormals.resize(tVertexCount);
+    std::for_each(std::execution::par_unseq, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+        contactNormals[i] = vec3(0);
+        if (vertices[i].invMass == 0) return;
+        vec3 p0 = previousPositions[i];
+        vec3 p1 = vertices[i].position;
+        for (const Plane& pl : bodyPlanes) {
+            float s0 = dot(pl.normal, p0) - pl.offset;
+            float s1 = dot(pl.normal, p1) - pl.offset;
+            if (s1 >= 0) continue;
+            // time of impact along the segment, or the start if it was already behind the plane
+            float t = s0 > 0 ? s0 / (s0 - s1) : 0;
+            vec3 c = p0 + (p1 - p0) * t;
+            c -= pl.normal * (dot(pl.normal, c) - pl.offset);
+            p1 = resolveContact(c, p1, pl.normal);
+            contactNormals[i] = pl.normal;
         }
+        if (!obstacles.empty()) {
+            // boxes are axis-aligned in the world, so test there
+            vec3 w0 = vec3(transform * vec4(p0, 1));
+            vec3 w1 = vec3(transform * vec4(p1, 1));
+            bool hit = false;
+            for (const BVH::AABB& box : obstacles) {
+                vec3 n = vec3(0), c;
+                vec3 d = w1 - w0;
+                // slab test for where the segment enters the box, which catches vertices that would pass right through it. the entry face is on the axis entered last
+                vec3 tLow = (box.low - w0) / d, tHigh = (box.high - w0) / d;
+                vec3 tNear = min(tLow, tHigh), tFar = max(tLow, tHigh);
+                int axis = tNear.x > tNear.y ? (tNear.x > tNear.z ? 0 : 2) : (tNear.y > tNear.z ? 1 : 2);
+                float tExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+                bool crosses = !box.contains(w0) && tNear[axis] >= 0 && tNear[axis] <= 1 && tNear[axis] <= tExit;
+                if (!crosses && !box.contains(w1)) continue;
+                if (crosses) {
+                    n[axis] = d[axis] > 0 ? -1 : 1;
+                    c = w0 + d * tNear[axis];
+                    c[axis] = d[axis] > 0 ? box.low[axis] : box.high[axis];
+                } else {
+                    // started inside, so leave through the closest face
+                    vec3 toLow = w1 - box.low, toHigh = box.high - w1;
+                    vec3 depth = min(toLow, toHigh);
+                    axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2) : (depth.y < depth.z ? 1 : 2);
+                    n[axis] = toLow[axis] < toHigh[axis] ? -1 : 1;
+                    c = w1;
+                    c[axis] = n[axis] < 0 ? box.low[axis] : box.high[axis];
+                }
+                w1 = resolveContact(c, w1, n);
+                contactNormals[i] = mat3(toBody) * n;
+                hit = true;
+            }
+            if (hit) p1 = vec3(toBody * vec4(w1, 1));
+        }
+        for (size_t c = 0; c < colliders.size(); ++c) {
+            vec3 p = vec3(toCollider[c].first * vec4(p1, 1));
+            if (colliders[c]->project(p, collisionMargin)) p1 = vec3(toCollider[c].second * vec4(p, 1));
+        }
+        vertices[i].position = p1;
     });
 }
 
+// end position of a vertex moving to `end` that touched a surface with normal `normal` at `contact`.
+// the vertex stays on the surface, and its sliding is cut by `friction` times how far it would have gone through
+vec3 SoftBody::resolveContact(vec3 contact, vec3 end, vec3 normal) {
+    vec3 r = end - contact;
+    float depth = -dot(r, normal);
+    vec3 slide = r + normal * depth;
+    float l = length(slide);
+    if (l > 0) slide *= std::max(0.f, 1 - friction * depth / l);
+    return contact + slide;
+}
+
 void SoftBody::update() {
-    sdt = dt / substeps;
-    for (int i = 0; i < substeps; ++i) {
-        applyForces();
-        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
-            if (vertices[i].invMass == 0) return;
-            previousPositions[i] = vertices[i].position;
-            vertices[i].position += vertices[i].velocity * sdt;
-        });
-        constrainBounds();
+    TRACE_SCOPE_CAT("SoftBody::update", "sim");
+    int steps = backend == SHAPE_MATCHING ? 1 : substeps;  // shape matching moves vertices to goals rather than along forces, so it is stable at any step
+    sdt = dt / steps;
+    for (int i = 0; i < steps; ++i) {
+        TRACE_SCOPE_CAT("SoftBody::substep", "sim");
+        integrate(i);
+        solve();
+        updateVelocities();
+    }
+    postUpdate();
+}
+
+// apply external forces and predict positions for substep `step` of the frame
+void SoftBody::integrate(int step) {
+    applyForces();
+    std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+        if (vertices[i].invMass == 0) return;
+        previousPositions[i] = vertices[i].position;
+        vertices[i].position += vertices[i].velocity * sdt;
+    });
+    // the grabbed vertex is kinematic, so move it along the cursor's path over the frame
+    if (grabbed >= 0) vertices[grabbed].position = mix(grabStart, grabTarget, std::min((step + 1) * sdt / dt, 1.f));
+}
+
+// project every constraint on the predicted positions. collisions go last, so the sweep covers the whole substep's motion
+// and nothing pushes a vertex back through a thin obstacle afterwards
+void SoftBody::solve() {
+    if (backend == PROJECTIVE_DYNAMICS) {
+        solveProjective();
+    } else if (backend == SHAPE_MATCHING) {
+        solveShapeMatching();
+    } else if (backend == FEM) {
+        if (multigrid && lod == 0) solveCoarse();
+        solveFEMConstraint();
+    } else if (partitioned) {
+        if (multigrid && lod == 0) solveCoarse();
+        solvePartitioned();
+    } else {
+        if (multigrid && lod == 0) solveCoarse();
         solveEdgeConstraint();
         solveVolumeConstraint();
-        std::for_each(std::execution::par, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
-            if (vertices[i].invMass == 0) return;
-            vertices[i].velocity = (vertices[i].position - previousPositions[i]) / sdt;
-        });
     }
-    updateVisualMesh();
+    if (localGrab && grabbed >= 0) solveGrabRegion();
+    if (selfCollision) solveSelfCollision();
+    constrainBounds();
+}
+
+// derive velocities from how far the solve moved each vertex. vertices that hit a plane or box bounce off with `restitution` of the speed they hit it at
+void SoftBody::updateVelocities() {
+    std::for_each(std::execution::par_unseq, tvIndices.begin(), tvIndices.end(), [&](auto&& i) {
+        if (vertices[i].invMass == 0) return;
+        vec3 v = (vertices[i].position - previousPositions[i]) / sdt;
+        if (restitution > 0 && i < (int)contactNormals.size()) {
+            vec3 n = contactNormals[i];
+            float vIn = dot(vertices[i].velocity, n);  // still the velocity before this substep
+            if (vIn < 0) v += n * (-restitution * vIn - dot(v, n));
+        }
+        vertices[i].velocity = v;
+    });
+}
+
+// once all substeps of the frame are done
+void SoftBody::postUpdate() {
+    if (grabbed >= 0) {
+        vertices[grabbed].velocity = (grabTarget - grabStart) / dt;  // carried over on release
+        grabStart = grabTarget;
+    }
+    surfaceDirty = true;
+    if (!gpuSkinning && visible) updateVisualMesh();
 }
@@ -3,15 +3,27 @@
 
 #include <fstream>
 #include <iostream>
+#include <atomic>
 #include <execution>
 #include <set>
 #include <list>
+#include <numeric>
+#include <unordered_map>
 
 #include "util.h"
 #include "staticmesh.h"
+#include "procmesh.h"
+#include "bvh.h"
+#include "sdf.h"
+#include "cholesky.h"
 
 #define TETRAPATH(m) MODELPATH(m) + "Tetra/" + MODEL_NO_DIR(m) + ".tetra"
 
+// SSBO bindings used by softBody.vert for GPU skinning
+#define SB_TETRAMAP_BINDING 3
+#define SB_TETRA_BINDING 4
+#define SB_POSITION_BINDING 5
+
 class SoftBody {
    public:
     SoftBody(std::string nm, StaticMesh* mesh_) {
@@ -26,25 +38,80 @@ class SoftBody {
         mesh->useCustomVertices = true; // enable use of custom vertices
         mesh->loadMesh(meshPath);
         loadTetraFile();
-
-        tetraCount = tetras.size();
-        tVertexCount = vertices.size();
-        mVertexCount = mesh->vertices.size();
-        tvIndices.resize(tVertexCount);
-        mvIndices.resize(mVertexCount);
-        tetraMap.resize(mVertexCount);
-        std::iota(tvIndices.begin(), tvIndices.end(), 0);  // set to 0, 1, 2, ..., tVertexCount
-        std::iota(mvIndices.begin(), mvIndices.end(), 0);  // set to 0, 1, 2, ..., mVertexCount
-        initHash();
-        initPhysics();
-        computeSkinningInfo();
-        bounds = {50, 50, 50};
+        initBody();
+    }
+    // Create a soft body from a procedurally generated shape. The visual mesh's buffers are only populated if `populate` is set (requires an OpenGL context)
+    SoftBody(std::string nm, const ProcMesh::TetMesh& tm, bool populate = true) {
+        name = nm;
+        mesh = ProcMesh::buildSurfaceMesh(tm, nm + "_Static", false);
+        mesh->useCustomVertices = true; // enable use of custom vertices
+        if (populate) {
+            mesh->populateBuffers();
+            glBindVertexArray(0);
+        }
+        cellSize = std::min(std::min(tm.size.x / tm.cells.x, tm.size.y / tm.cells.y), tm.size.z / tm.cells.z);
+        loadTetMesh(tm);
+        initBody();
     }
 
+    // Boundary face of tetrahedron `tID`, opposite its corner `corner`
+    struct SurfaceFace {
+        int tID;
+        int corner;
+        ivec3 v;  // tetrahedral vertex IDs of the face
+    };
+
+    // Solid half-space behind the plane dot(normal, x) = offset
+    struct Plane {
+        vec3 normal;
+        float offset;
+    };
+
+    // Constraint solver used each substep
+    enum SolverBackend {
+        XPBD,                // Gauss-Seidel-like edge and volume projections, tuned by `edgeCompliance` and `volumeCompliance`
+        PROJECTIVE_DYNAMICS, // local/global solve of per-tetrahedron strain against a prefactored system, tuned by `projectiveStiffness`
+        FEM,                 // XPBD projection of a corotated material, one fused pass over the tetrahedra, tuned by `youngsModulus` and `poissonRatio`
+        SHAPE_MATCHING       // overlapping clusters of vertices pulled towards rotated copies of their rest shape, in a single substep. for near-rigid bodies
+    };
+
+    // Factored global step of the projective dynamics backend for one tetrahedral mesh
+    struct ProjectiveSystem {
+        SkylineCholesky cholesky;                   // (M / h^2 + sum of w G^T G) over the vertices, shared by x, y, and z
+        std::vector<double> inertia;                // mass of each vertex over the squared substep. pinned vertices get a large mass
+        std::vector<int> incidentOffsets;           // CSR offsets into `incident` for each vertex (tVertexCount + 1 entries)
+        std::vector<std::pair<int, int>> incident;  // tetrahedra each vertex is a corner of, and which corner
+        float step = 0, stiffness = 0;              // substep and stiffness the system was factored for
+    };
+
+    // Result of a ray query
+    struct RayHit {
+        int tID = -1;  // tetrahedron hit
+        vec4 bary;     // barycentric coords of the hit point in the tetrahedron, in corner order (x1, x2, x3, x4)
+        float t = 0;   // distance along the ray
+        vec3 point;    // hit point
+    };
+
     void loadTetraFile();
+    void loadTetraFile(std::string path);
+    void loadTetMesh(const ProcMesh::TetMesh& tm);
+    void initBody();
     float computeTetraVolume(int t);
     float computeTetraVolume(vec3 p1, vec3 p2, vec3 p3, vec3 p4);
     void update();
+    void integrate(int step);
+    void solve();
+    void updateVelocities();
+    void postUpdate();
+    void buildTetBVH();
+    void refitTetBVH();
+    void initSurface();
+    void refitSurface();
+    bool raycast(vec3 origin, vec3 dir, RayHit& hit, float tMax = FLT_MAX);
+    bool grab(vec3 origin, vec3 dir);
+    void moveGrab(vec3 origin, vec3 dir);
+    void releaseGrab();
+    void collectGrabRegion(int tID);
     void computeSkinningInfo();
     long long getHashKey(ivec3 cell);
     ivec3 getCellCoord(vec3 p);
@@ -53,9 +120,25 @@ class SoftBody {
     void initPhysics();
     void applyForces();
     void constrainBounds();
+    vec3 resolveContact(vec3 contact, vec3 end, vec3 normal);
     void solveEdgeConstraint();
     void solveVolumeConstraint();
+    void solveFEMConstraint();
+    void initClusters();
+    void solveShapeMatching();
+    void initPartitions();
+    void solvePartitioned();
+    void solveGrabRegion();
+    void initProjective();
+    void solveProjective();
+    void initSelfCollision();
+    void buildSelfCollisionHash();
+    void solveSelfCollision();
     void updateVisualMesh();
+    void initNormals();
+    void updateNormals(const vec3* positions);
+    void initGPUSkinning();
+    void render(Shader* shader, mat4 model);
 
     struct Vertex {
         int vID;
@@ -77,8 +160,39 @@ class SoftBody {
         int x1, x2, x3, x4;
         float restVolume = 0;  // rest volume
         Tetra(int id, int w, int x, int y, int z) : tID(id), x1(w), x2(x), x3(y), x4(z) {}
+        int corner(int k) const { return k == 0 ? x1 : k == 1 ? x2 : k == 2 ? x3 : x4; }
+    };
+
+    void solveEdge(const Edge& e);
+    void solveTetra(const Tetra& tet);
+    void solveFEM(const Tetra& tet, float alphaD, float alphaH);
+
+    // Tetrahedral mesh at one resolution, with its own embedding of the visual mesh.
+    // Each level's vertices are interpolated from level 0's and vice versa, to carry positions and velocities across a switch
+    struct Level {
+        std::vector<Vertex> vertices;
+        std::vector<Edge> edges;
+        std::vector<Tetra> tetras;
+        std::vector<std::tuple<int, int, int, int>> tetraNeighbours;
+        std::vector<std::pair<int, vec3>> tetraMap;
+        std::vector<int> inFullOffsets;             // CSR offsets into `inFull` for each of this level's vertices
+        std::vector<std::pair<int, float>> inFull;  // level 0 vertices and weights in the right-hand side of each of this level's vertices' fit
+        std::vector<std::pair<int, vec4>> fullIn;   // tetrahedron of this level and barycentric coords of each level 0 vertex
+        SkylineCholesky restriction;                // normal equations of fitting this level's vertices to level 0 through `fullIn`
+        std::vector<mat3> restShapes;
+        std::vector<vec3> restPositions;
+        ProjectiveSystem projective;
     };
 
+    void buildLODs(int count, float coarsening = 2);
+    void swapLevel(Level& level);
+    void setLOD(int level);
+    void solveCoarse();
+    float distanceTo(vec3 p);
+    int selectLOD(vec3 cameraPos);
+    int levelTetraCount(int level);
+
+
     StaticMesh* mesh;                            // mesh to base the soft body from
     std::vector<Vertex> vertices;                // tetrahedra vertices
     std::vector<Edge> edges;                     // tetrahedra edges
@@ -86,6 +200,7 @@ class SoftBody {
     std::vector<std::pair<int, vec3>> tetraMap;  // mapping of visual mesh vertices to tetrahedra IDs and their (3D) barycentric coords
     std::vector<std::tuple<int, int, int, int>> tetraNeighbours;
 
+    SolverBackend backend = XPBD;
     float edgeCompliance = 1;
     float volumeCompliance = 0;
     float cellSize = 0.1;  // grid size for particles. in 3D, particles are single points rather than spheres with radii
@@ -99,9 +214,91 @@ class SoftBody {
     vec3 bounds;
     float floorY = 0;
 
+    /* Collision */
+    std::vector<Plane> planes;            // world-space planes to collide with, in addition to the floor
+    std::vector<BVH::AABB> obstacles;     // solid world-space boxes to collide with
+    float friction = 0.3f;                // Coulomb friction coefficient against planes and boxes
+    float restitution = 0;                // fraction of the normal speed kept when bouncing off planes and boxes
+    std::vector<vec3> contactNormals;     // normal of each vertex's plane or box contact this substep (in the body's space), or 0
+    std::vector<SDFCollider*> colliders;  // static scenery to collide with
+    float collisionMargin = 0.01f;        // distance vertices are kept from collider surfaces
+
     std::vector<int> tvIndices;  // indices of tetrahedral mesh
     std::vector<int> mvIndices;  // indices of visual mesh
 
+    BVH tetBVH;                         // hierarchy over the tetrahedra, built at rest pose for skinning and refit for collision queries
+    std::vector<BVH::AABB> tetBoxes;    // bounds of the tetrahedra, reused between refits
+
+    /* Ray queries */
+    std::vector<SurfaceFace> surfaceFaces;  // boundary faces of the tetrahedral mesh
+    std::vector<int> sfIndices;             // 0 to the surface face count, for iterating faces in parallel
+    BVH surfaceBVH;                         // hierarchy over `surfaceFaces`, refit to the deformed positions when queried
+    std::vector<BVH::AABB> surfaceBoxes;    // bounds of `surfaceFaces`, reused between refits
+    bool surfaceDirty = true;               // have vertices moved since `surfaceBVH` was last refit?
+
+    /* Mouse grabbing */
+    mat4 transform = mat4(1);       // model matrix the body is drawn with, for mapping world-space rays into the body's space
+    int grabbed = -1;               // tetrahedral vertex held by the cursor, or -1
+    float grabInvMass = 0;          // inverse mass of the grabbed vertex, restored on release
+    float grabDepth = 0;            // distance along the cursor ray the grabbed vertex is held at
+    vec3 grabOffset;                // grabbed vertex position relative to the hit point, so it does not jump to the ray
+    vec3 grabStart, grabTarget;     // grabbed vertex position at the start of the frame, and where the cursor ray holds it
+    bool localGrab = false;         // run extra solver iterations on the constraints around the grabbed vertex
+    int grabRings = 3;              // rings of neighbouring tetrahedra around the grabbed one to relax
+    int grabIterations = 4;         // extra iterations per substep for the grab region
+    std::vector<int> grabTetras;    // tetrahedra within `grabRings` of the grabbed one
+    std::vector<int> grabEdges;     // edges between vertices of `grabTetras`
+
+    /* FEM */
+    float youngsModulus = 2e3f;         // stiffness of the material (for a density of 1)
+    float poissonRatio = 0.45f;         // resistance to volume change, approaching incompressible at 0.5
+
+    /* Shape matching */
+    float clusterSize = 0;                    // side of the cells clusters are made of. 0 for four times the mean rest edge length
+    float shapeStiffness = 1;                 // fraction of the way to their clusters' goal positions vertices are moved each substep
+    std::vector<vec3> restPositions;          // vertex positions at rest, as set up by `initPhysics`
+    std::vector<int> clusterIDs;              // 0 to the cluster count, for iterating clusters in parallel
+    std::vector<int> clusterOffsets;          // CSR offsets into `clusterMembers` for each cluster
+    std::vector<int> clusterMembers;          // vertices of each cluster
+    std::vector<int> vertexClusterOffsets;    // CSR offsets into `vertexClusters` for each vertex
+    std::vector<int> vertexClusters;          // clusters each vertex is in
+    std::vector<mat3> clusterRotations;       // rotation of each cluster from its last match, to start the next one from
+    std::vector<vec3> clusterCentres;         // centre of mass of each cluster's vertices, this substep
+    std::vector<vec3> clusterRestCentres;     // centre of mass of each cluster's rest positions, with this substep's masses
+
+    /* Partitioned solving */
+    bool partitioned = false;                 // solve XPBD edges and volumes cluster by cluster, with a coloured pass over the constraints between clusters
+    int partitionSize = 4096;                 // tetrahedra per cluster. 4096 is about 200 KB of vertices, edges and tetrahedra, to stay in L2
+    int partitionIterations = 2;              // passes over each cluster's interior constraints per substep
+    std::vector<int> partitionIDs;            // 0 to the cluster count, for iterating clusters in parallel
+    std::vector<int> partitionEdgeOffsets;    // CSR offsets into `partitionEdges` for each cluster
+    std::vector<int> partitionEdges;          // edges with both vertices owned by one cluster
+    std::vector<int> partitionTetraOffsets;   // CSR offsets into `partitionTetras` for each cluster
+    std::vector<int> partitionTetras;         // tetrahedra with all corners owned by one cluster
+    std::vector<int> boundaryEdgeOffsets;     // CSR offsets into `boundaryEdges` for each colour
+    std::vector<int> boundaryEdges;           // edges between vertices of different clusters, grouped by colour
+    std::vector<int> boundaryTetraOffsets;    // CSR offsets into `boundaryTetras` for each colour
+    std::vector<int> boundaryTetras;          // tetrahedra with corners in more than one cluster, grouped by colour
+
+    /* Projective dynamics */
+    float projectiveStiffness = 1e5f;   // resistance of each tetrahedron to strain, per unit rest volume
+    int projectiveIterations = 4;       // local/global iterations per substep
+    std::vector<mat3> restShapes;       // inverse of each tetrahedron's rest edge matrix [x2 - x1, x3 - x1, x4 - x1], also used by FEM
+    std::vector<mat3> tetRotations;     // rotation of each tetrahedron from the last local step (or FEM projection), to start the next one from
+    ProjectiveSystem projective;        // factored when first needed, and again when `sdt` or `projectiveStiffness` change
+    std::vector<vec3> inertialPositions;  // positions predicted by `integrate`, which the global step is pulled towards
+    std::vector<double> projectiveRHS;    // right-hand sides of the global step, x then y then z
+
+    /* Simulation level of detail */
+    std::vector<Level> levels;          // level 0 is the loaded mesh, then coarser cages. the active level lives in the members above and its slot is empty
+    int lod = 0;                        // active level
+    std::vector<float> lodDistances;    // camera distance from which each coarser level is used (levels.size() - 1 entries)
+    float lodHysteresis = 0.1f;         // fraction of a distance the camera must come back past before a finer level is used
+    bool multigrid = false;             // at level 0, solve the coarse levels first each substep and carry their corrections down
+    int coarseIterations = 2;           // solver iterations per coarse level per substep
+    std::vector<vec3> coarseStart;      // coarse level positions before its iterations, to find its correction
+    std::vector<float> coarseInvMass;   // coarse level inverse masses, while the vertices held by level 0 are pinned
+
     /* Hash variables */
     int tableSize = 0;
     int querySize = 0;
@@ -109,6 +306,35 @@ class SoftBody {
     std::map<long long, std::list<int>> cellToVis; // sparse mapping of grid cell hashes to visual mesh vertex IDs
     std::vector<vec3> previousPositions; // previous positions of tetrahedral vertices
 
+    /* Self-collision */
+    bool selfCollision = false;             // keep non-adjacent surface vertices at least `selfCollisionDist` apart
+    float selfCollisionDist = 0;            // minimum distance between surface vertices. 0 picks half the mean rest edge length
+    std::vector<int> surfaceVertices;       // tetrahedral vertices on the surface
+    std::vector<int> svIndices;             // 0 to the surface vertex count, for iterating surface vertices in parallel
+    std::vector<int> neighbourOffsets;      // CSR offsets into `neighbours` for each tetrahedral vertex (tVertexCount + 1 entries)
+    std::vector<int> neighbours;            // vertices sharing an edge with each vertex, sorted
+    std::vector<int> cellStart;             // first entry of each hash cell in `cellEntries` (tableSize + 1 entries)
+    std::vector<int> cellEntries;           // indices into `surfaceVertices`, grouped by hash cell
+    std::vector<int> vertexHashes;          // hash cell of each surface vertex
+    std::vector<vec3> selfCorrections;      // averaged separation of each surface vertex, applied after every vertex is gathered
+
+    /* Normal recomputation */
+    bool recomputeNormals = false;      // recompute visual mesh normals after every `updateVisualMesh()`. not available with `gpuSkinning`
+    std::vector<ivec3> triangles;       // visual mesh triangles, with submesh base vertices applied
+    std::vector<int> triIndices;        // 0 to the triangle count, for iterating triangles in parallel
+    std::vector<int> vertexTriOffsets;  // CSR offsets into `vertexTris` for each visual vertex (mVertexCount + 1 entries)
+    std::vector<int> vertexTris;        // triangles adjacent to each visual vertex
+    std::vector<vec3> faceNormals;      // area-weighted normal of each triangle
+
+    /* Visibility */
+    bool visible = true;  // is the body in view? invisible bodies still simulate, but skip skinning and uploading their visual mesh
+
+    /* GPU skinning */
+    bool gpuSkinning = false;                   // embed visual vertices in the vertex shader, so only tetrahedral positions are uploaded
+    GLuint tetraMapSSBO = 0;                    // barycentric coords and tetrahedron ID of each visual vertex
+    GLuint tetraSSBO = 0;                       // vertex indices of each tetrahedron
+    StreamBuffer* positionStream = nullptr;     // tetrahedral vertex positions, rewritten every frame
+
     std::string name;
     std::string tetraPath;
 };
@@ -1,6 +1,9 @@
 #include "staticmesh.h"
 
-StaticMesh::~StaticMesh() {}
+StaticMesh::~StaticMesh() {
+    delete p_Stream;
+    delete n_Stream;
+}
 
 /// <summary>
 /// Load a mesh with a given name.
@@ -8,6 +11,7 @@ StaticMesh::~StaticMesh() {}
 /// <param name="file_name">The full name of the model to load.</param>
 /// <returns>A boolean. True if loading succeeds, false otherwise.</returns>
 bool StaticMesh::loadMesh(std::string file_name, bool popBuffers) {
+    TRACE_SCOPE_CAT("StaticMesh::loadMesh", "load");
     populateBuffer = popBuffers;
     mesh_path = file_name;
 
@@ -183,7 +187,15 @@ void StaticMesh::populateBuffers() {
 
     glBindBuffer(GL_ARRAY_BUFFER, p_VBO);
     if (useCustomVertices) {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * vertices.size(), NULL, GL_STATIC_DRAW);
+        // custom vertices are rewritten every frame, so stream them through a persistently mapped buffer
+        p_Stream = new StreamBuffer(sizeof(vec3) * vertices.size(), vertices.data());
+        if (p_Stream->ptr) {
+            glBindBuffer(GL_ARRAY_BUFFER, p_Stream->ID);
+        } else {
+            delete p_Stream;
+            p_Stream = nullptr;
+            glBufferData(GL_ARRAY_BUFFER, sizeof(vec3) * vertices.size(), NULL, GL_STATIC_DRAW);
+        }
     } else {
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices[0], GL_DYNAMIC_DRAW);
     }
@@ -191,7 +203,17 @@ void StaticMesh::populateBuffers() {
     glVertexAttribPointer(ST_POSITION_LOC, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
     glBindBuffer(GL_ARRAY_BUFFER, n_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), &normals[0], GL_STATIC_DRAW);
+    if (useCustomVertices && !normals.empty()) {
+        // normals of custom vertices may be recomputed every frame too
+        n_Stream = new StreamBuffer(sizeof(vec3) * normals.size(), normals.data());
+        if (n_Stream->ptr) {
+            glBindBuffer(GL_ARRAY_BUFFER, n_Stream->ID);
+        } else {
+            delete n_Stream;
+            n_Stream = nullptr;
+        }
+    }
+    if (!n_Stream) glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), &normals[0], GL_STATIC_DRAW);
     glEnableVertexAttribArray(ST_NORMAL_LOC);
     glVertexAttribPointer(ST_NORMAL_LOC, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
@@ -232,10 +254,19 @@ void StaticMesh::setCustomVertices(std::vector<vec3> vs) {
 /// <param name="nInstances">The number of instances you would like to draw.</param>
 /// <param name="model_matrix">The matrices you would like to transform each instance with.</param>
 void StaticMesh::render(unsigned int nInstances, const mat4* model_matrix, const float* atlasDepths) {
+    TRACE_SCOPE_CAT("StaticMesh::render", "render");
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, IBO);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(mat4) * nInstances, &model_matrix[0]);
-    if (useCustomVertices) {
+    if (p_Stream) {
+        // draw from the slice written this frame
+        glBindBuffer(GL_ARRAY_BUFFER, p_Stream->ID);
+        glVertexAttribPointer(ST_POSITION_LOC, 3, GL_FLOAT, GL_FALSE, 0, (const void*)p_Stream->offset());
+        if (n_Stream) {
+            glBindBuffer(GL_ARRAY_BUFFER, n_Stream->ID);
+            glVertexAttribPointer(ST_NORMAL_LOC, 3, GL_FLOAT, GL_FALSE, 0, (const void*)n_Stream->offset());
+        }
+    } else if (useCustomVertices) {
         glBindBuffer(GL_ARRAY_BUFFER, p_VBO);
         // glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec3) * cVertices.size(), &cVertices[0]);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec3) * vertices.size(), &vertices[0]);
@@ -268,6 +299,8 @@ void StaticMesh::render(unsigned int nInstances, const mat4* model_matrix, const
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
     }
+    if (p_Stream) p_Stream->fence();
+    if (n_Stream) n_Stream->fence();
     glBindVertexArray(0);  // prevent VAO from being changed externally
 }
 
@@ -0,0 +1,52 @@
+#include "streambuffer.h"
+
+#include <cstring>
+
+#include "trace.h"
+
+StreamBuffer::StreamBuffer(GLsizeiptr size, const void* data, GLsizeiptr alignment) {
+    this->size = size;
+    sliceSize = (size + alignment - 1) / alignment * alignment;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &ID);
+    glNamedBufferStorage(ID, sliceSize * STREAM_SLICES, nullptr, flags);
+    ptr = (char*)glMapNamedBufferRange(ID, 0, sliceSize * STREAM_SLICES, flags);
+    if (!ptr) {
+        fprintf(stderr, "Failed to map stream buffer of %lld bytes\n", (long long)sliceSize * STREAM_SLICES);
+        return;
+    }
+    if (data) {
+        for (int i = 0; i < STREAM_SLICES; ++i) memcpy(ptr + i * sliceSize, data, size);
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync& f : fences) {
+        if (f) glDeleteSync(f);
+    }
+    if (ptr) glUnmapNamedBuffer(ID);
+    glDeleteBuffers(1, &ID);
+}
+
+void* StreamBuffer::map() {
+    if (!ptr) return nullptr;
+    slice = (slice + 1) % STREAM_SLICES;
+    if (GLsync f = fences[slice]) {
+        TRACE_SCOPE_CAT("StreamBuffer::wait", "render");
+        // flush on the first wait only, so the fence is guaranteed to be signalled eventually
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            GLenum res = glClientWaitSync(f, waitFlags, 1000000);  // 1ms
+            if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED || res == GL_WAIT_FAILED) break;
+            waitFlags = 0;
+        }
+        glDeleteSync(f);
+        fences[slice] = nullptr;
+    }
+    return ptr + offset();
+}
+
+void StreamBuffer::fence() {
+    if (fences[slice]) glDeleteSync(fences[slice]);
+    fences[slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
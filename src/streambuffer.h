@@ -0,0 +1,38 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/gl.h>
+
+#include <cstdio>
+
+#define STREAM_SLICES 3  // frames that can be in flight at once
+
+// Persistently and coherently mapped buffer for data rewritten every frame, split into `STREAM_SLICES` slices.
+// The CPU writes one slice while the GPU reads the others, and each slice is guarded by a fence, so neither a copy nor an implicit sync is needed.
+// Usage each frame: `map()` and fill the returned slice, draw using `offset()`, then `fence()` once the draws reading it are issued.
+// Requires an OpenGL 4.4+ context.
+class StreamBuffer {
+   public:
+    // Create a stream of `STREAM_SLICES` slices of `size` bytes each, every slice initialised to `data` if given.
+    // Slices start on multiples of `alignment` bytes (e.g. GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT for ranged SSBO bindings)
+    StreamBuffer(GLsizeiptr size, const void* data = nullptr, GLsizeiptr alignment = 1);
+    ~StreamBuffer();
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Move on to the next slice, waiting for the GPU to finish reading it if needed, and return it for writing. Returns null if mapping failed
+    void* map();
+    // Byte offset of the current slice into the buffer, for attribute pointers or ranged bindings
+    GLintptr offset() const { return slice * sliceSize; }
+    // Mark the current slice as in use by the draws issued so far
+    void fence();
+
+    GLuint ID = 0;
+    GLsizeiptr size = 0;       // usable bytes per slice
+    GLsizeiptr sliceSize = 0;  // bytes between slices
+    int slice = 0;             // slice currently being drawn from
+    char* ptr = nullptr;       // start of the mapped buffer
+    GLsync fences[STREAM_SLICES] = {};
+};
+
+#endif /* STREAMBUFFER_H */
@@ -0,0 +1,99 @@
+#include "streamingsoftbody.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+#include "trace.h"
+
+bool StreamingSoftBody::load(const std::string& path) {
+    TRACE_SCOPE_CAT("StreamingSoftBody::load", "load");
+    if (!store.open(path)) return false;
+    int n = store.header.vertexCount;
+    positions.assign(store.positions(), store.positions() + n);
+    invMass.assign(store.invMasses(), store.invMasses() + n);
+    previousPositions = positions;
+    velocities.assign(n, vec3(0));
+    vIndices.resize(n);
+    std::iota(vIndices.begin(), vIndices.end(), 0);
+    uint32_t largest = 0;
+    for (uint32_t c = 0; c < store.header.chunkCount; ++c) largest = std::max({largest, store.chunks()[c].edgeCount, store.chunks()[c].tetraCount});
+    chunkIndices.resize(largest);
+    std::iota(chunkIndices.begin(), chunkIndices.end(), 0);
+    return true;
+}
+
+void StreamingSoftBody::update() {
+    TRACE_SCOPE_CAT("StreamingSoftBody::update", "sim");
+    sdt = dt / substeps;
+    int chunks = store.header.chunkCount;
+    for (int s = 0; s < substeps; ++s) {
+        integrate();
+        for (int c = 0; c < std::min(prefetchChunks, chunks); ++c) store.prefetch(c);
+        for (int c = 0; c < chunks; ++c) {
+            if (c + prefetchChunks < chunks) store.prefetch(c + prefetchChunks);
+            solveChunk(c);
+            store.release(c);
+        }
+        constrainFloor();
+        updateVelocities();
+    }
+}
+
+void StreamingSoftBody::integrate() {
+    std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+        if (invMass[i] == 0) return;
+        velocities[i] += Util::DOWN * gravity * sdt;
+        previousPositions[i] = positions[i];
+        positions[i] += velocities[i] * sdt;
+    });
+}
+
+// the edge and volume constraints of chunk `c`, projected as in `SoftBody::solveEdge` and `SoftBody::solveTetra`
+void StreamingSoftBody::solveChunk(int c) {
+    TRACE_SCOPE_CAT("StreamingSoftBody::solveChunk", "sim");
+    const TetStore::Chunk& chunk = store.chunks()[c];
+    const TetStore::Edge* edges = store.edges() + chunk.firstEdge;
+    const TetStore::Tetra* tetras = store.tetras() + chunk.firstTetra;
+    float edgeAlpha = edgeCompliance / (sdt * sdt);
+    float volumeAlpha = volumeCompliance / (sdt * sdt);
+    std::for_each(std::execution::par, chunkIndices.begin(), chunkIndices.begin() + chunk.edgeCount, [&](int k) {
+        const TetStore::Edge& e = edges[k];
+        float w1 = invMass[e.x1], w2 = invMass[e.x2];
+        if (w1 + w2 == 0) return;
+        vec3 d = positions[e.x1] - positions[e.x2];
+        float l = length(d);
+        if (l == 0) return;
+        float lambda = -(l - e.restLength) / (w1 + w2 + edgeAlpha);
+        d /= l;
+        positions[e.x1] += lambda * w1 * d;
+        positions[e.x2] -= lambda * w2 * d;
+    });
+    std::for_each(std::execution::par, chunkIndices.begin(), chunkIndices.begin() + chunk.tetraCount, [&](int k) {
+        const TetStore::Tetra& t = tetras[k];
+        vec3 p1 = positions[t.x[0]], p2 = positions[t.x[1]], p3 = positions[t.x[2]], p4 = positions[t.x[3]];
+        float w[4] = {invMass[t.x[0]], invMass[t.x[1]], invMass[t.x[2]], invMass[t.x[3]]};
+        vec3 grad[4] = {cross(p4 - p2, p3 - p2) / 6.f, cross(p3 - p1, p4 - p1) / 6.f, cross(p4 - p1, p2 - p1) / 6.f, cross(p2 - p1, p3 - p1) / 6.f};
+        float denom = 0;
+        for (int j = 0; j < 4; ++j) denom += w[j] * length2(grad[j]);
+        if (denom == 0) return;
+        float C = dot(grad[3], p4 - p1) - t.restVolume;
+        float lambda = -C / (denom + volumeAlpha);
+        for (int j = 0; j < 4; ++j) positions[t.x[j]] += lambda * w[j] * grad[j];
+    });
+}
+
+// keep vertices above the floor
+void StreamingSoftBody::constrainFloor() {
+    std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+        if (invMass[i] == 0) return;
+        positions[i].y = std::max(positions[i].y, floorY);
+    });
+}
+
+void StreamingSoftBody::updateVelocities() {
+    std::for_each(std::execution::par_unseq, vIndices.begin(), vIndices.end(), [&](int i) {
+        if (invMass[i] == 0) return;
+        velocities[i] = (positions[i] - previousPositions[i]) / sdt;
+    });
+}
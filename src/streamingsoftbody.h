@@ -0,0 +1,40 @@
+#ifndef STREAMINGSOFTBODY_H
+#define STREAMINGSOFTBODY_H
+
+#include <string>
+#include <vector>
+
+#include "tetstore.h"
+#include "util.h"
+
+// Soft body whose topology is streamed from a memory-mapped `TetStore` rather than held in memory. Only the per-vertex state is in memory;
+// each substep walks the chunks in order, reading ahead the next `prefetchChunks` and releasing each once solved, so the resident part of
+// the topology stays at a few chunks whatever the mesh size. Runs the XPBD edge and volume constraints, gravity and the floor, in the body's space
+class StreamingSoftBody {
+   public:
+    bool load(const std::string& path);
+    void update();
+    void integrate();
+    void solveChunk(int c);
+    void constrainFloor();
+    void updateVelocities();
+
+    TetStore store;
+    std::vector<vec3> positions;
+    std::vector<vec3> previousPositions;  // positions at the start of the substep
+    std::vector<vec3> velocities;
+    std::vector<float> invMass;
+    std::vector<int> vIndices;            // 0 to the vertex count, for iterating vertices in parallel
+    std::vector<int> chunkIndices;        // 0 to the largest chunk's edge or tetrahedron count, for iterating a chunk in parallel
+
+    float edgeCompliance = 1;
+    float volumeCompliance = 0;
+    float gravity = 0;
+    float floorY = 0;
+    float dt = 1.f / 120;
+    int substeps = 10;
+    float sdt = dt / substeps;
+    int prefetchChunks = 1;               // chunks read ahead of the one being solved
+};
+
+#endif /* STREAMINGSOFTBODY_H */
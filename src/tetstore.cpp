@@ -0,0 +1,241 @@
+#include "tetstore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <numeric>
+
+#ifdef _WIN32
+#define NOMINMAX  // keep std::min and std::max usable
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bvh.h"
+#include "softbody.h"
+#include "trace.h"
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE) {
+        printf("Could not open %s\n", path.c_str());
+        return false;
+    }
+    LARGE_INTEGER length;
+    GetFileSizeEx(f, &length);
+    HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        printf("Could not map %s\n", path.c_str());
+        if (m) CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+    file = f;
+    mapping = m;
+    size = length.QuadPart;
+    data = (const char*)view;
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Could not open %s\n", path.c_str());
+        close();
+        return false;
+    }
+    size = st.st_size;
+    void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        printf("Could not map %s\n", path.c_str());
+        close();
+        return false;
+    }
+    data = (const char*)view;
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    file = mapping = nullptr;
+#else
+    if (data) munmap((void*)data, size);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// the system's page size, queried once
+static size_t pageSize() {
+    static const size_t page = [] {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (size_t)info.dwPageSize;
+#else
+        return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }();
+    return page;
+}
+
+// hints work on whole pages, so widen the range to the pages it touches
+static void pageRange(const char* base, size_t offset, size_t length, size_t fileSize, char*& start, size_t& bytes) {
+    size_t page = pageSize();
+    length = std::min(length, fileSize - std::min(offset, fileSize));
+    size_t first = offset / page * page;
+    start = (char*)base + first;
+    bytes = offset + length - first;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+    char* start;
+    size_t bytes;
+    pageRange(data, offset, length, size, start, bytes);
+    if (bytes == 0) return;
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range = {start, bytes};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(start, bytes, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::release(size_t offset, size_t length) const {
+    char* start;
+    size_t bytes;
+    pageRange(data, offset, length, size, start, bytes);
+    if (bytes == 0) return;
+#ifdef _WIN32
+    VirtualUnlock(start, bytes);  // trims unlocked pages from the working set, though it reports an error for them
+#else
+    madvise(start, bytes, MADV_DONTNEED);  // the mapping is read-only, so the pages are just read again when next touched
+#endif
+}
+
+// sort `count` items along a Morton curve through `centre(i)`, returning each item's code and the order
+template <typename F>
+static void mortonOrder(int count, F centre, vec3 low, vec3 extent, std::vector<unsigned long long>& keys) {
+    std::vector<int> ids(count);
+    std::iota(ids.begin(), ids.end(), 0);
+    keys.resize(count);
+    std::for_each(std::execution::par, ids.begin(), ids.end(), [&](int i) {
+        unsigned long long code = BVH::morton3D((centre(i) - low) / extent);
+        keys[i] = (code << 32) | (unsigned int)i;
+    });
+    std::sort(std::execution::par, keys.begin(), keys.end());
+}
+
+bool TetStore::write(const std::string& path, const SoftBody& body, int chunkTetras) {
+    TRACE_SCOPE_CAT("TetStore::write", "load");
+    const auto& vertices = body.vertices;
+    BVH::AABB bounds;
+    for (const auto& v : vertices) bounds.grow(v.position);
+    vec3 extent = max(bounds.high - bounds.low, vec3(1e-12f));
+
+    std::vector<unsigned long long> tetraKeys, edgeKeys;
+    mortonOrder(body.tetras.size(), [&](int i) {
+        const SoftBody::Tetra& t = body.tetras[i];
+        return (vertices[t.x1].position + vertices[t.x2].position + vertices[t.x3].position + vertices[t.x4].position) * 0.25f;
+    }, bounds.low, extent, tetraKeys);
+    mortonOrder(body.edges.size(), [&](int i) {
+        const SoftBody::Edge& e = body.edges[i];
+        return (vertices[e.x1].position + vertices[e.x2].position) * 0.5f;
+    }, bounds.low, extent, edgeKeys);
+
+    // each chunk starts at a tetrahedron, and takes the edges from the first one at or past that tetrahedron's place on the curve
+    std::vector<Chunk> chunks;
+    chunkTetras = std::max(chunkTetras, 1);
+    for (size_t t = 0; t < tetraKeys.size(); t += chunkTetras) {
+        Chunk c;
+        c.firstTetra = t;
+        c.tetraCount = std::min<size_t>(chunkTetras, tetraKeys.size() - t);
+        unsigned long long start = t == 0 ? 0 : tetraKeys[t] & ~0xFFFFFFFFull;
+        c.firstEdge = std::lower_bound(edgeKeys.begin(), edgeKeys.end(), start) - edgeKeys.begin();
+        chunks.push_back(c);
+    }
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        uint32_t end = c + 1 < chunks.size() ? chunks[c + 1].firstEdge : edgeKeys.size();
+        chunks[c].edgeCount = end - chunks[c].firstEdge;
+    }
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        printf("Could not write %s\n", path.c_str());
+        return false;
+    }
+    Header header;
+    header.vertexCount = vertices.size();
+    header.edgeCount = body.edges.size();
+    header.tetraCount = body.tetras.size();
+    header.chunkCount = chunks.size();
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(chunks.data(), sizeof(Chunk), chunks.size(), f);
+    for (const auto& v : vertices) fwrite(&v.position, sizeof(vec3), 1, f);
+    for (const auto& v : vertices) fwrite(&v.invMass, sizeof(float), 1, f);
+    for (unsigned long long key : edgeKeys) {
+        const SoftBody::Edge& e = body.edges[key & 0xFFFFFFFF];
+        Edge out = {(uint32_t)e.x1, (uint32_t)e.x2, e.restLength};
+        fwrite(&out, sizeof(out), 1, f);
+    }
+    for (unsigned long long key : tetraKeys) {
+        const SoftBody::Tetra& t = body.tetras[key & 0xFFFFFFFF];
+        Tetra out = {{(uint32_t)t.x1, (uint32_t)t.x2, (uint32_t)t.x3, (uint32_t)t.x4}, t.restVolume};
+        fwrite(&out, sizeof(out), 1, f);
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    if (!ok) printf("Could not write %s\n", path.c_str());
+    return ok;
+}
+
+bool TetStore::open(const std::string& path) {
+    if (!file.open(path)) return false;
+    if (file.size < sizeof(Header)) {
+        printf("%s is too small to be a tetrahedron store\n", path.c_str());
+        file.close();
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(Header));
+    if (memcmp(header.magic, "TETS", 4) != 0 || header.version != 1) {
+        printf("%s is not a version 1 tetrahedron store\n", path.c_str());
+        file.close();
+        return false;
+    }
+    positionOffset = sizeof(Header) + sizeof(Chunk) * header.chunkCount;
+    invMassOffset = positionOffset + sizeof(vec3) * header.vertexCount;
+    edgeOffset = invMassOffset + sizeof(float) * header.vertexCount;
+    tetraOffset = edgeOffset + sizeof(Edge) * header.edgeCount;
+    if (tetraOffset + sizeof(Tetra) * header.tetraCount > file.size) {
+        printf("%s is truncated\n", path.c_str());
+        file.close();
+        return false;
+    }
+    printf("Mapped %s: %u vertices, %u edges, %u tetrahedra in %u chunks\n", path.c_str(), header.vertexCount, header.edgeCount, header.tetraCount,
+           header.chunkCount);
+    return true;
+}
+
+void TetStore::prefetch(int c) const {
+    const Chunk& chunk = chunks()[c];
+    file.prefetch(edgeOffset + sizeof(Edge) * chunk.firstEdge, sizeof(Edge) * chunk.edgeCount);
+    file.prefetch(tetraOffset + sizeof(Tetra) * chunk.firstTetra, sizeof(Tetra) * chunk.tetraCount);
+}
+
+void TetStore::release(int c) const {
+    const Chunk& chunk = chunks()[c];
+    file.release(edgeOffset + sizeof(Edge) * chunk.firstEdge, sizeof(Edge) * chunk.edgeCount);
+    file.release(tetraOffset + sizeof(Tetra) * chunk.firstTetra, sizeof(Tetra) * chunk.tetraCount);
+}
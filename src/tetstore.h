@@ -0,0 +1,89 @@
+#ifndef TETSTORE_H
+#define TETSTORE_H
+
+#include <cstdint>
+#include <string>
+
+#include "util.h"
+
+class SoftBody;
+
+// Read-only memory mapping of a whole file. Pages are only read in when touched, so a file larger than memory can be mapped.
+// `prefetch` and `release` hint which ranges are about to be read and which are done with, to bound how much of it stays resident
+class MappedFile {
+   public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    // Start reading `length` bytes from `offset` in the background
+    void prefetch(size_t offset, size_t length) const;
+    // Drop `length` bytes from `offset` from the working set. they are read again if touched later
+    void release(size_t offset, size_t length) const;
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+   private:
+#ifdef _WIN32
+    void* file = nullptr;     // HANDLE
+    void* mapping = nullptr;  // HANDLE
+#else
+    int fd = -1;
+#endif
+};
+
+// Compact tetrahedral topology on disk, for meshes too large to hold as `SoftBody` edges and tetrahedra, read through a memory mapping.
+// Edges and tetrahedra are 32-bit vertex indices and a rest value, without ID fields. Both are sorted along a Morton curve and cut into chunks
+// of nearby tetrahedra, with each chunk's edges being those whose midpoints lie on the same stretch of the curve.
+// Layout: header, chunk table, vertex positions, inverse masses, edges, tetrahedra
+class TetStore {
+   public:
+    struct Header {
+        char magic[4] = {'T', 'E', 'T', 'S'};
+        uint32_t version = 1;
+        uint32_t vertexCount = 0;
+        uint32_t edgeCount = 0;
+        uint32_t tetraCount = 0;
+        uint32_t chunkCount = 0;
+    };
+
+    struct Edge {
+        uint32_t x1, x2;
+        float restLength;
+    };  // 12 bytes, against 16 for `SoftBody::Edge`
+
+    struct Tetra {
+        uint32_t x[4];
+        float restVolume;
+    };  // 20 bytes, against 24 for `SoftBody::Tetra`
+
+    struct Chunk {
+        uint32_t firstEdge, edgeCount;
+        uint32_t firstTetra, tetraCount;
+    };
+
+    // Write the tetrahedral mesh of `body` to `path`, in chunks of about `chunkTetras` tetrahedra
+    static bool write(const std::string& path, const SoftBody& body, int chunkTetras = 1 << 16);
+    bool open(const std::string& path);
+
+    const Chunk* chunks() const { return (const Chunk*)(file.data + sizeof(Header)); }
+    const vec3* positions() const { return (const vec3*)(file.data + positionOffset); }  // where each vertex starts
+    const float* invMasses() const { return (const float*)(file.data + invMassOffset); }
+    const Edge* edges() const { return (const Edge*)(file.data + edgeOffset); }
+    const Tetra* tetras() const { return (const Tetra*)(file.data + tetraOffset); }
+
+    // Read ahead the edges and tetrahedra of chunk `c`
+    void prefetch(int c) const;
+    // Let the edges and tetrahedra of chunk `c` leave the working set
+    void release(int c) const;
+
+    Header header;
+    MappedFile file;
+    size_t positionOffset = 0, invMassOffset = 0, edgeOffset = 0, tetraOffset = 0;  // byte offsets of each array in the file
+};
+
+#endif /* TETSTORE_H */
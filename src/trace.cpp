@@ -0,0 +1,110 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace {
+
+std::atomic<bool> enabled = false;  // off until asked for, so unused scopes only cost the load
+
+// Single-producer ring buffer owned by one thread. `head` is the total number of events ever written;
+// event `i` lives in slot `i % TRACE_CAPACITY` until it is overwritten by event `i + TRACE_CAPACITY`
+struct Buffer {
+    std::unique_ptr<Event[]> events = std::make_unique<Event[]>(TRACE_CAPACITY);
+    std::atomic<unsigned long long> head = 0;
+    std::atomic<unsigned long long> cleared = 0;  // events before this index were dropped by `clear()`
+    int tid;
+    std::string threadName;
+};
+
+// every thread's buffer. buffers are never freed, so events from finished threads can still be exported
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<Buffer>> buffers;
+
+static Buffer* registerThread() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    auto b = std::make_unique<Buffer>();
+    b->tid = buffers.size();
+    b->threadName = "Worker " + std::to_string(b->tid);
+    buffers.push_back(std::move(b));
+    return buffers.back().get();
+}
+
+static Buffer* threadBuffer() {
+    thread_local Buffer* buffer = registerThread();
+    return buffer;
+}
+
+void record(const char* name, const char* cat, long long start, long long end) {
+    Buffer* b = threadBuffer();
+    unsigned long long h = b->head.load(std::memory_order_relaxed);
+    b->events[h % TRACE_CAPACITY] = {name, cat, start, end - start};
+    b->head.store(h + 1, std::memory_order_release);
+}
+
+void setThreadName(std::string name) {
+    Buffer* b = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    b->threadName = name;
+}
+
+void clear() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (auto& b : buffers) b->cleared.store(b->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+// write `s` as a JSON string
+static void writeString(FILE* f, const std::string& s) {
+    fputc('"', f);
+    for (char c : s) {
+        if (c == '"' || c == '\\') fputc('\\', f);
+        fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+bool exportJSON(std::string path) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        printf("Failed to open trace file %s\n", path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    std::vector<Event> events;
+    size_t total = 0;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (auto& b : buffers) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", b->tid);
+        writeString(f, b->threadName);
+        fprintf(f, "}}");
+        first = false;
+
+        // copy the live window of the ring, then discard anything the owning thread may have overwritten while copying
+        unsigned long long end = b->head.load(std::memory_order_acquire);
+        unsigned long long begin = std::max(b->cleared.load(std::memory_order_relaxed), end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0);
+        events.clear();
+        for (unsigned long long i = begin; i < end; ++i) events.push_back(b->events[i % TRACE_CAPACITY]);
+        unsigned long long after = b->head.load(std::memory_order_acquire);
+        size_t skip = after >= TRACE_CAPACITY && after - TRACE_CAPACITY + 1 > begin ? std::min<size_t>(after - TRACE_CAPACITY + 1 - begin, events.size()) : 0;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const Event& e = events[i];
+            fprintf(f, ",\n{\"name\":");
+            writeString(f, e.name);
+            fprintf(f, ",\"cat\":");
+            writeString(f, e.cat);
+            fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", b->tid, e.start * 1e-3, e.dur * 1e-3);
+        }
+        total += events.size() - skip;
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    printf("Saved %zu trace events to \"%s\"\n", total, path.c_str());
+    return true;
+}
+};  // namespace Trace
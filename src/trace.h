@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#define TRACE_CAPACITY (1 << 16)  // events kept per thread before the oldest are overwritten
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#ifndef DISABLE_TRACE
+// time the enclosing scope. `name` must be a string literal (or otherwise outlive the program)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+// time the enclosing scope under category `cat`
+#define TRACE_SCOPE_CAT(name, cat) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name, cat)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_CAT(name, cat)
+#endif
+
+// Timeline recorder for scoped markers, exported as Chrome/Perfetto trace event JSON (open in ui.perfetto.dev or chrome://tracing).
+// Each thread records into its own ring buffer, so recording never locks; a mutex is only taken the first time a thread records.
+namespace Trace {
+
+struct Event {
+    const char* name;
+    const char* cat;
+    long long start;  // ns since the trace epoch
+    long long dur;    // ns
+};
+
+// Whether scopes are currently being recorded. off by default; turned on from the debug UI or the first F9
+extern std::atomic<bool> enabled;
+
+// Nanoseconds since the trace epoch (program start)
+inline long long now() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Record a complete event on the calling thread
+extern void record(const char* name, const char* cat, long long start, long long end);
+// Name the calling thread in exported traces. Threads that are not named show up as "Worker N"
+extern void setThreadName(std::string name);
+// Write every recorded event still in the ring buffers to `path`. Can be called while other threads are recording
+extern bool exportJSON(std::string path);
+// Drop all recorded events
+extern void clear();
+
+// Records the time between its construction and destruction
+struct Scope {
+    const char* name;
+    const char* cat;
+    long long start = -1;
+    Scope(const char* nm, const char* c = "app") : name(nm), cat(c) {
+        if (enabled.load(std::memory_order_relaxed)) start = now();
+    }
+    ~Scope() {
+        if (start >= 0) record(name, cat, start, now());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+};  // namespace Trace
+
+#endif /* TRACE_H */
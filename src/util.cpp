@@ -128,6 +128,73 @@ float sqDist(vec3 a, vec3 b) {
     return dot(diff, diff);
 }
 
+// Compute the barycentric coordinates of `p` in the tetrahedron `abcd`. All are non-negative if `p` is inside the tetrahedron
+vec4 tetraBarycentric(vec3 p, vec3 a, vec3 b, vec3 c, vec3 d) {
+    mat3 P = mat3(a - d, b - d, c - d);
+    vec3 bary = inverse(P) * (p - d);  // p - d = P * bary
+    return vec4(bary, 1 - bary.x - bary.y - bary.z);
+}
+
+// Find the point on triangle `abc` closest to `p`
+// From Real-Time Collision Detection (Ericson), 5.1.5
+vec3 closestPointOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c) {
+    vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+
+    vec3 bp = p - b;
+    float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+    vec3 cp = p - c;
+    float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Compute the squared distance between `p` and the (solid) tetrahedron `abcd`. 0 if `p` is inside
+float sqDistToTetra(vec3 p, vec3 a, vec3 b, vec3 c, vec3 d) {
+    vec4 bary = tetraBarycentric(p, a, b, c, d);
+    if (bary.x >= 0 && bary.y >= 0 && bary.z >= 0 && bary.w >= 0) return 0;
+    // the closest point lies on a face that `p` is outside of, i.e. one opposite a negative coordinate
+    float dist = std::numeric_limits<float>::max();
+    if (bary.x < 0) dist = std::min(dist, sqDist(p, closestPointOnTriangle(p, b, c, d)));
+    if (bary.y < 0) dist = std::min(dist, sqDist(p, closestPointOnTriangle(p, a, c, d)));
+    if (bary.z < 0) dist = std::min(dist, sqDist(p, closestPointOnTriangle(p, a, b, d)));
+    if (bary.w < 0) dist = std::min(dist, sqDist(p, closestPointOnTriangle(p, a, b, c)));
+    return dist;
+}
+
+// Intersect the ray `o + t * d` with triangle `abc` (either side). On a hit, `t` is set and `uv` are the barycentric weights of `b` and `c`
+// Möller-Trumbore intersection
+bool rayTriangle(vec3 o, vec3 d, vec3 a, vec3 b, vec3 c, float& t, vec2& uv) {
+    vec3 ab = b - a, ac = c - a;
+    vec3 p = cross(d, ac);
+    float det = dot(ab, p);
+    if (fabs(det) < 1e-12f) return false;  // parallel
+    float invDet = 1 / det;
+    vec3 ao = o - a;
+    float u = dot(ao, p) * invDet;
+    if (u < 0 || u > 1) return false;
+    vec3 q = cross(ao, ab);
+    float v = dot(d, q) * invDet;
+    if (v < 0 || u + v > 1) return false;
+    t = dot(ac, q) * invDet;
+    uv = vec2(u, v);
+    return t >= 0;
+}
+
 // Convert degrees to radians
 float d2r(float val) { return glm::radians(val); }
 
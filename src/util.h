@@ -27,6 +27,7 @@
 #include <assimp/postprocess.h>  // various extra operations
 
 #include "sm.h"
+#include "trace.h"
 
 #define ARRAY_LENGTH(a) sizeof(a) / sizeof(a[0])
 #define PROJDIR "../"                                                    // path from executable to workspace folder
@@ -59,6 +60,10 @@ extern std::string readFile(const char* path);
 extern float wrap(float val, float min, float max);
 extern vec3 wrapV(vec3 val, vec3 min, vec3 max);
 extern float sqDist(vec3 a, vec3 b);
+extern vec4 tetraBarycentric(vec3 p, vec3 a, vec3 b, vec3 c, vec3 d);
+extern vec3 closestPointOnTriangle(vec3 p, vec3 a, vec3 b, vec3 c);
+extern float sqDistToTetra(vec3 p, vec3 a, vec3 b, vec3 c, vec3 d);
+extern bool rayTriangle(vec3 o, vec3 d, vec3 a, vec3 b, vec3 c, float& t, vec2& uv);
 extern float clamp(float val, float min, float max);
 extern vec3 clampV(vec3 val, vec3 min, vec3 max);
 extern float d2r(float val);
@@ -3,6 +3,7 @@
 VariantMesh::~VariantMesh() {}
 
 bool VariantMesh::loadMeshes(std::vector<VariantInfo *> infos) {
+    TRACE_SCOPE_CAT("VariantMesh::loadMeshes", "load");
     bool valid = true;
     boneTransformOffsets.push_back(0);
     for (auto v : infos) {
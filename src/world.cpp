@@ -0,0 +1,189 @@
+#include "world.h"
+
+void PhysicsWorld::add(SoftBody* body) {
+    bodies.push_back(body);
+    if (body->surfaceVertices.empty()) body->initSelfCollision();  // the surface vertices each body's contacts start from
+    bounds.emplace_back();
+    order.push_back(bodies.size() - 1);
+    bodyPairs.emplace_back();
+}
+
+void PhysicsWorld::update() {
+    TRACE_SCOPE_CAT("PhysicsWorld::update", "sim");
+    updateBounds();
+    if (camera) updateVisibility();
+    broadphase();
+    for (SoftBody* b : bodies) {
+        b->dt = dt;
+        b->substeps = substeps;
+        b->sdt = dt / substeps;
+        if (b->surfaceVertices.empty()) b->initSelfCollision();  // cleared by a level switch since the last step
+    }
+    for (int i = 0; i < substeps; ++i) {
+        TRACE_SCOPE_CAT("PhysicsWorld::substep", "sim");
+        for (SoftBody* b : bodies) {
+            b->integrate(i);
+            b->solve();
+        }
+        if (!pairs.empty()) narrowphase();
+        for (SoftBody* b : bodies) b->updateVelocities();
+    }
+    for (SoftBody* b : bodies) b->postUpdate();
+}
+
+// each body's level by camera distance, then coarser levels for the farthest bodies until the total fits the budget
+void PhysicsWorld::updateLOD(vec3 cameraPos) {
+    TRACE_SCOPE_CAT("PhysicsWorld::updateLOD", "sim");
+    std::vector<int> levels(bodies.size());
+    std::vector<float> distances(bodies.size());
+    long long total = 0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        levels[i] = bodies[i]->selectLOD(cameraPos);
+        distances[i] = bodies[i]->distanceTo(cameraPos);
+        total += bodies[i]->levelTetraCount(levels[i]);
+    }
+    if (tetraBudget > 0 && total > tetraBudget) {
+        std::vector<int> farthest(bodies.size());
+        std::iota(farthest.begin(), farthest.end(), 0);
+        std::sort(farthest.begin(), farthest.end(), [&](int a, int b) { return distances[a] > distances[b]; });
+        for (int i : farthest) {
+            SoftBody* b = bodies[i];
+            while (total > tetraBudget && levels[i] + 1 < (int)b->levels.size()) {
+                total -= b->levelTetraCount(levels[i]);
+                total += b->levelTetraCount(++levels[i]);
+            }
+            if (total <= tetraBudget) break;
+        }
+    }
+    for (size_t i = 0; i < bodies.size(); ++i) bodies[i]->setLOD(levels[i]);
+}
+
+// world-space box of each body, from its vertices' bounds in its own space
+void PhysicsWorld::updateBounds() {
+    TRACE_SCOPE_CAT("PhysicsWorld::updateBounds", "sim");
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](int i) {
+        SoftBody* b = bodies[i];
+        BVH::AABB local = std::transform_reduce(
+            std::execution::par_unseq, b->vertices.begin(), b->vertices.end(), BVH::AABB(),
+            [](BVH::AABB x, const BVH::AABB& y) {
+                x.grow(y);
+                return x;
+            },
+            [](const SoftBody::Vertex& v) { return BVH::AABB(v.position, v.position); });
+        vec3 corner = vec3(b->transform * vec4(local.low, 1));
+        Box box(corner, corner);
+        for (int c = 1; c < 8; ++c) {
+            vec3 p = vec3(c & 1 ? local.high.x : local.low.x, c & 2 ? local.high.y : local.low.y, c & 4 ? local.high.z : local.low.z);
+            box.grow(vec3(b->transform * vec4(p, 1)));
+        }
+        bounds[i] = Box(box.low - vec3(boundsMargin), box.high + vec3(boundsMargin));
+    });
+}
+
+// test each body's box against the camera's frustum, before the bodies skin their visual meshes at the end of the frame
+void PhysicsWorld::updateVisibility() {
+    TRACE_SCOPE_CAT("PhysicsWorld::updateVisibility", "sim");
+    mat4 viewProjection = camera->getPerspectiveMatrix() * camera->getViewMatrix();
+    for (size_t i = 0; i < bodies.size(); ++i) bodies[i]->visible = bounds[i].inFrustum(viewProjection);
+}
+
+// sweep and prune along x. bodies move a little each frame, so last frame's order is nearly sorted and the insertion sort does little work
+void PhysicsWorld::broadphase() {
+    TRACE_SCOPE_CAT("PhysicsWorld::broadphase", "sim");
+    for (size_t i = 1; i < order.size(); ++i) {
+        int body = order[i];
+        size_t j = i;
+        for (; j > 0 && bounds[order[j - 1]].low.x > bounds[body].low.x; --j) order[j] = order[j - 1];
+        order[j] = body;
+    }
+    pairs.clear();
+    for (auto& bp : bodyPairs) bp.clear();
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Box& bi = bounds[order[i]];
+        // only bodies starting before this one ends can overlap it
+        for (size_t j = i + 1; j < order.size() && bounds[order[j]].low.x <= bi.high.x; ++j) {
+            const Box& bj = bounds[order[j]];
+            if (bi.high.y < bj.low.y || bj.high.y < bi.low.y || bi.high.z < bj.low.z || bj.high.z < bi.low.z) continue;
+            int a = std::min(order[i], order[j]), b = std::max(order[i], order[j]);
+            bodyPairs[a].push_back({pairs.size(), true});
+            bodyPairs[b].push_back({pairs.size(), false});
+            pairs.push_back({a, b});
+        }
+    }
+}
+
+// is `p` (in `body`'s space) inside one of its tetrahedra?
+static bool insideBody(SoftBody* body, vec3 p) {
+    bool inside = false;
+    body->tetBVH.queryPoint(p, [&](int t) {
+        const SoftBody::Tetra& tet = body->tetras[t];
+        vec4 b = Util::tetraBarycentric(p, body->vertices[tet.x1].position, body->vertices[tet.x2].position, body->vertices[tet.x3].position, body->vertices[tet.x4].position);
+        inside = min(min(b.x, b.y), min(b.z, b.w)) >= 0;
+        return inside;
+    });
+    return inside;
+}
+
+// push the surface vertices of `from` that are inside a tetrahedron of `into` back out of `into`'s surface.
+// a vertex that was outside at the start of the substep goes back to where its path entered, so contacts do not push sideways;
+// one that was already inside goes to the closest surface point
+static void collide(SoftBody* from, SoftBody* into, std::vector<PhysicsWorld::Contact>& contacts) {
+    contacts.clear();
+    mat4 toInto = inverse(into->transform) * from->transform;
+    mat3 back = mat3(inverse(toInto));
+    Box intoBounds = into->tetBVH.bounds();
+    auto position = [&](int v) { return into->vertices[v].position; };
+    for (int v : from->surfaceVertices) {
+        if (from->vertices[v].invMass == 0) continue;
+        vec3 p = vec3(toInto * vec4(from->vertices[v].position, 1));
+        if (!intoBounds.contains(p) || !insideBody(into, p)) continue;
+        vec3 prev = vec3(toInto * vec4(from->previousPositions[v], 1));
+        vec3 target = p;
+        float t = 1;
+        int f = -1;
+        if (!insideBody(into, prev)) {
+            vec3 d = p - prev;
+            f = into->surfaceBVH.raycast(prev, d, t, [&](int i, float& tBest) {
+                const ivec3& tri = into->surfaceFaces[i].v;
+                float tHit;
+                vec2 uv;
+                if (!Util::rayTriangle(prev, d, position(tri.x), position(tri.y), position(tri.z), tHit, uv) || tHit > tBest) return false;
+                tBest = tHit;
+                return true;
+            });
+            if (f >= 0) target = prev + d * t;
+        }
+        if (f < 0) {
+            f = into->surfaceBVH.nearest(p, [&](int i, vec3 q) {
+                const ivec3& tri = into->surfaceFaces[i].v;
+                return Util::sqDist(q, Util::closestPointOnTriangle(q, position(tri.x), position(tri.y), position(tri.z)));
+            });
+            const ivec3& tri = into->surfaceFaces[f].v;
+            target = Util::closestPointOnTriangle(p, position(tri.x), position(tri.y), position(tri.z));
+        }
+        contacts.push_back({v, back * (target - p)});
+    }
+}
+
+// find the corrections for every pair in parallel, reading positions only, then apply them per body so no two threads write the same body
+void PhysicsWorld::narrowphase() {
+    TRACE_SCOPE_CAT("PhysicsWorld::narrowphase", "sim");
+    std::vector<char> involved(bodies.size(), 0);
+    for (const auto& p : pairs) involved[p.a] = involved[p.b] = 1;
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](int i) {
+        if (!involved[i]) return;
+        SoftBody* b = bodies[i];
+        b->refitTetBVH();
+        b->refitSurface();
+    });
+    std::for_each(std::execution::par, pairs.begin(), pairs.end(), [&](Pair& p) {
+        collide(bodies[p.a], bodies[p.b], p.contactsA);
+        collide(bodies[p.b], bodies[p.a], p.contactsB);
+    });
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](int i) {
+        SoftBody* b = bodies[i];
+        for (auto [p, isA] : bodyPairs[i]) {
+            for (const Contact& c : isA ? pairs[p].contactsA : pairs[p].contactsB) b->vertices[c.v].position += c.delta;
+        }
+    });
+}
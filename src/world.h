@@ -0,0 +1,53 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <execution>
+#include <vector>
+
+#include "box.h"
+#include "softbody.h"
+
+// Steps several soft bodies together and resolves collisions between them.
+// The broadphase keeps a world-space box per body and finds overlapping pairs by sweep and prune along x. The sweep order is kept between frames and
+// re-sorted with an insertion sort, which is close to linear while bodies move coherently.
+// Bodies outside `camera`'s view frustum are marked invisible from the same boxes, so they skip their visual mesh until they come back into view.
+// The narrowphase runs every substep over the overlapping pairs in parallel, pushing surface vertices of each body out of the other's tetrahedra.
+class PhysicsWorld {
+   public:
+    // Correction to a vertex of one body, in that body's space
+    struct Contact {
+        int v;
+        vec3 delta;
+    };
+
+    // Bodies whose boxes overlap, with the corrections found for each side this substep
+    struct Pair {
+        int a, b;
+        std::vector<Contact> contactsA;  // vertices of `a` pushed out of `b`
+        std::vector<Contact> contactsB;  // vertices of `b` pushed out of `a`
+    };
+
+    void add(SoftBody* body);
+    // Step every body by `dt`, in `substeps` substeps
+    void update();
+    void updateBounds();
+    void updateVisibility();
+    void broadphase();
+    void narrowphase();
+    // Pick each body's simulation level for a camera at `cameraPos`, within `tetraBudget`
+    void updateLOD(vec3 cameraPos);
+
+    std::vector<SoftBody*> bodies;
+    std::vector<Box> bounds;         // world-space box of each body, padded by `boundsMargin`
+    std::vector<int> order;          // bodies sorted by `bounds[i].low.x`, kept between frames
+    std::vector<Pair> pairs;         // overlapping pairs found by the last `broadphase()`
+    std::vector<std::vector<std::pair<int, bool>>> bodyPairs;  // pairs each body is in, and whether it is side `a`
+
+    float dt = 1.f / 120;
+    int substeps = 10;
+    float boundsMargin = 0.1f;  // padding so pairs found at the start of the frame still cover its substeps
+    Camera* camera = nullptr;   // when set, bodies whose bounds are outside its view still simulate but skip skinning their visual mesh
+    long long tetraBudget = 0;  // most tetrahedra to simulate across all bodies, reached by coarsening the farthest bodies first. 0 for no limit
+};
+
+#endif /* WORLD_H */
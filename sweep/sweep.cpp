@@ -0,0 +1,254 @@
+// Headless parameter sweep: simulates one scene for every combination of the given SoftBody parameters, spread over worker threads,
+// and writes per-run metrics as CSV or JSON (by the output's extension). Large grids can also be split over processes or machines with --shard.
+//
+//   sweep --shape sphere --tets 10000 --scene drop --frames 240 --edge-compliance 0,0.1,1 --substeps 5,10,20 --out results.csv
+//
+// Each parameter takes a comma-separated list of values; the grid is their cartesian product
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "procmesh.h"
+#include "softbody.h"
+#include "util.h"
+
+// one point of the grid, and what simulating it measured
+struct Run {
+    float edgeCompliance = 0;
+    float volumeCompliance = 0;
+    int substeps = 0;
+    float dt = 0;
+    float gravity = 0;
+
+    double seconds = 0;          // wall time spent stepping, without the measurements
+    double stepsPerSecond = 0;   // substeps per second of wall time
+    float volumeDrift = 0;       // largest relative change of the total volume over the run
+    float maxEdgeError = 0;      // largest relative stretch or compression of any edge over the run
+    float maxSpeed = 0;          // largest vertex speed over the run
+    int frames = 0;              // frames simulated, fewer than asked for if the run went unstable
+    std::string status = "stable";  // "stable", "exploded" (too fast or too far from where it started), "tangled" (an edge strained past the limit) or "nan"
+};
+
+struct Scene {
+    std::string shape = "sphere";  // cube or sphere
+    long long tets = 10000;        // approximate tetrahedra count
+    std::string name = "drop";     // drop: fall from `height` onto the floor. hang: top layer of vertices pinned, with no floor below
+    float size = 1;
+    float height = 1;
+    int frames = 240;
+    float maxSpeed = 100;          // speed past which a run counts as exploded
+    float maxStrain = 1;           // relative edge stretch or compression past which a run counts as tangled
+};
+
+static std::vector<float> parseList(const char* s) {
+    std::vector<float> values;
+    for (const std::string& token : Util::split(s, ",")) values.push_back(std::stof(token));
+    return values;
+}
+
+static void usage() {
+    printf("usage: sweep [options]\n"
+           "  --shape cube|sphere         body to simulate (sphere)\n"
+           "  --tets N                    approximate tetrahedra count (10000)\n"
+           "  --scene drop|hang           drop onto the floor, or hang from the top layer of vertices (drop)\n"
+           "  --frames N                  frames per run (240)\n"
+           "  --max-speed V               vertex speed past which a run counts as exploded (100)\n"
+           "  --max-strain S              relative edge strain past which a run counts as tangled (1)\n"
+           "  --edge-compliance a,b,...   values to sweep (0)\n"
+           "  --volume-compliance a,b,... (0)\n"
+           "  --substeps a,b,...          (10)\n"
+           "  --dt a,b,...                (1/120)\n"
+           "  --gravity a,b,...           (9.81)\n"
+           "  --jobs N                    runs simulated at once (hardware threads)\n"
+           "  --shard i/n                 only the runs with index %% n == i, to split a grid over processes\n"
+           "  --out path                  .json for JSON, anything else for CSV (sweep.csv)\n");
+}
+
+static float totalVolume(SoftBody& sb) {
+    float v = 0;
+    for (int t = 0; t < sb.tetraCount; ++t) v += sb.computeTetraVolume(t);
+    return v;
+}
+
+// simulate one run to completion, or until it goes unstable
+static void simulate(const Scene& scene, const ProcMesh::TetMesh& tm, Run& run) {
+    SoftBody sb("Sweep", tm, false);
+    sb.visible = false;  // nothing is drawn, so skip skinning the visual mesh
+    sb.edgeCompliance = run.edgeCompliance;
+    sb.volumeCompliance = run.volumeCompliance;
+    sb.substeps = run.substeps;
+    sb.dt = run.dt;
+    sb.gravity = run.gravity;
+    // the shapes are built resting on y = 0, where the floor is, so start them `height` above it
+    for (auto& v : sb.vertices) v.position.y += scene.height;
+    float extent = scene.size + scene.height;
+    if (scene.name == "hang") {
+        float top = -FLT_MAX;
+        for (const auto& v : sb.vertices) top = std::max(top, v.position.y);
+        for (auto& v : sb.vertices) {
+            if (v.position.y > top - 1e-4f) v.invMass = 0;
+        }
+        sb.floorY = -10 * extent;  // out of reach however far it sags, as a run that far out counts as exploded
+    }
+    float restVolume = totalVolume(sb);
+
+    for (int f = 0; f < scene.frames; ++f) {
+        auto start = std::chrono::steady_clock::now();
+        sb.update();
+        run.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        run.frames = f + 1;
+        bool finite = true;
+        for (const auto& v : sb.vertices) {
+            if (!std::isfinite(v.position.x + v.position.y + v.position.z)) finite = false;
+            run.maxSpeed = std::max(run.maxSpeed, length(v.velocity));
+            if (length(v.position) > 10 * extent) run.status = "exploded";
+        }
+        if (!finite) {
+            run.status = "nan";
+            break;
+        }
+        if (run.maxSpeed > scene.maxSpeed) run.status = "exploded";
+        if (run.status != "stable") break;
+        for (const auto& e : sb.edges) {
+            float l = distance(sb.vertices[e.x1].position, sb.vertices[e.x2].position);
+            run.maxEdgeError = std::max(run.maxEdgeError, std::abs(l / e.restLength - 1));
+        }
+        run.volumeDrift = std::max(run.volumeDrift, std::abs(totalVolume(sb) / restVolume - 1));
+        if (run.maxEdgeError > scene.maxStrain) {
+            run.status = "tangled";
+            break;
+        }
+    }
+    run.stepsPerSecond = run.frames * run.substeps / std::max(run.seconds, 1e-9);
+    delete sb.mesh;  // made for the body by its constructor, but not freed with it
+}
+
+static bool writeCSV(const std::string& path, const std::vector<Run>& runs) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        printf("Could not write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(f, "edgeCompliance,volumeCompliance,substeps,dt,gravity,frames,seconds,stepsPerSecond,volumeDrift,maxEdgeError,maxSpeed,status\n");
+    for (const Run& r : runs) {
+        fprintf(f, "%g,%g,%d,%g,%g,%d,%.4f,%.1f,%g,%g,%g,%s\n", r.edgeCompliance, r.volumeCompliance, r.substeps, r.dt, r.gravity, r.frames, r.seconds,
+                r.stepsPerSecond, r.volumeDrift, r.maxEdgeError, r.maxSpeed, r.status.c_str());
+    }
+    fclose(f);
+    return true;
+}
+
+static bool writeJSON(const std::string& path, const Scene& scene, const std::vector<Run>& runs) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        printf("Could not write %s\n", path.c_str());
+        return false;
+    }
+    fprintf(f, "{\"scene\":{\"shape\":\"%s\",\"tets\":%lld,\"name\":\"%s\",\"frames\":%d},\"runs\":[\n", scene.shape.c_str(), scene.tets, scene.name.c_str(),
+            scene.frames);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const Run& r = runs[i];
+        fprintf(f,
+                "%s{\"edgeCompliance\":%g,\"volumeCompliance\":%g,\"substeps\":%d,\"dt\":%g,\"gravity\":%g,\"frames\":%d,\"seconds\":%.4f,"
+                "\"stepsPerSecond\":%.1f,\"volumeDrift\":%g,\"maxEdgeError\":%g,\"maxSpeed\":%g,\"status\":\"%s\"}",
+                i ? ",\n" : "", r.edgeCompliance, r.volumeCompliance, r.substeps, r.dt, r.gravity, r.frames, r.seconds, r.stepsPerSecond, r.volumeDrift,
+                r.maxEdgeError, r.maxSpeed, r.status.c_str());
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Scene scene;
+    std::map<std::string, std::vector<float>> grid = {
+        {"edge-compliance", {0}}, {"volume-compliance", {0}}, {"substeps", {10}}, {"dt", {1.f / 120}}, {"gravity", {9.81f}}};
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    int shard = 0, shards = 1;
+    std::string out = "sweep.csv";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printf("Missing value for %s\n", arg.c_str());
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg.rfind("--", 0) == 0 && grid.count(arg.substr(2))) grid[arg.substr(2)] = parseList(value);
+        else if (arg == "--shape") scene.shape = value;
+        else if (arg == "--tets") scene.tets = std::atoll(value);
+        else if (arg == "--scene") scene.name = value;
+        else if (arg == "--frames") scene.frames = std::atoi(value);
+        else if (arg == "--max-speed") scene.maxSpeed = std::atof(value);
+        else if (arg == "--max-strain") scene.maxStrain = std::atof(value);
+        else if (arg == "--jobs") jobs = std::max(1, std::atoi(value));
+        else if (arg == "--shard") {
+            if (sscanf(value, "%d/%d", &shard, &shards) != 2 || shards < 1 || shard < 0 || shard >= shards) {
+                printf("Bad shard %s, expected i/n\n", value);
+                return 1;
+            }
+        } else if (arg == "--out") out = value;
+        else {
+            printf("Unknown option %s\n", arg.c_str());
+            usage();
+            return 1;
+        }
+    }
+    if (scene.shape != "cube" && scene.shape != "sphere") {
+        printf("Unknown shape %s\n", scene.shape.c_str());
+        return 1;
+    }
+
+    // cartesian product of the grid, keeping this shard's runs
+    std::vector<Run> runs;
+    int index = 0;
+    for (float ec : grid["edge-compliance"])
+        for (float vc : grid["volume-compliance"])
+            for (float ss : grid["substeps"])
+                for (float dt : grid["dt"])
+                    for (float g : grid["gravity"]) {
+                        if (index++ % shards != shard) continue;
+                        Run r;
+                        r.edgeCompliance = ec;
+                        r.volumeCompliance = vc;
+                        r.substeps = std::max(1, (int)ss);
+                        r.dt = dt;
+                        r.gravity = g;
+                        runs.push_back(r);
+                    }
+
+    int subdivisions = ProcMesh::subdivisionsFor(scene.tets);
+    ProcMesh::TetMesh tm = scene.shape == "cube" ? ProcMesh::cube(subdivisions, scene.size) : ProcMesh::sphere(subdivisions, scene.size / 2);
+    printf("Sweeping %zu runs of %d frames on %d threads\n", runs.size(), scene.frames, jobs);
+
+    // each worker takes the next run until there are none left. the bodies' own parallel loops share the remaining cores
+    std::atomic<int> next = 0, done = 0;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < std::min<int>(jobs, runs.size()); ++w) {
+        workers.emplace_back([&]() {
+            for (int i = next++; i < (int)runs.size(); i = next++) {
+                simulate(scene, tm, runs[i]);
+                printf("[%d/%zu] edge %g volume %g substeps %d dt %g gravity %g: %s, %.0f steps/s\n", ++done, runs.size(), runs[i].edgeCompliance,
+                       runs[i].volumeCompliance, runs[i].substeps, runs[i].dt, runs[i].gravity, runs[i].status.c_str(), runs[i].stepsPerSecond);
+            }
+        });
+    }
+    for (auto& t : workers) t.join();
+
+    bool json = out.size() >= 5 && out.compare(out.size() - 5, 5, ".json") == 0;
+    if (!(json ? writeJSON(out, scene, runs) : writeCSV(out, runs))) return 1;
+    printf("Wrote %s\n", out.c_str());
+    return 0;
+}